@@ -0,0 +1,425 @@
+#include "codec.h"
+#include "decoder.h"
+#include "encoder.h"
+#include "filter.h"
+#include "messages.h"
+#include "sampling.h"
+#include "search.h"
+#include "speculative.h"
+#include "static_table.h"
+#include "tree.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Prints one line per benchmark: name, value and unit, separated by spaces.
+// If names are passed as arguments, only benchmarks which names start with
+// one of them are run
+
+namespace {
+using bench_clock = std::chrono::steady_clock;
+
+constexpr size_t REPEATS = 5;
+
+struct benchmark {
+  std::string name;
+  std::string unit;
+  std::function<double()> run;
+};
+
+// text-like data: skewed distribution of bytes
+std::string generate_data(size_t size, uint32_t seed) {
+  std::string result(size, '\0');
+  uint32_t state = seed;
+  for (char& ch : result) {
+    state = state * 1664525u + 1013904223u;
+    uint32_t value = state >> 24u;
+    ch = static_cast<char>('a' + (value * value >> 11u));
+  }
+  return result;
+}
+
+// telemetry-like data: runs of equal bytes of skewed lengths
+std::string generate_runs(size_t size, uint32_t seed) {
+  std::string result = generate_data(size, seed);
+  uint32_t state = seed;
+  for (size_t i = 0; i < size;) {
+    state = state * 1664525u + 1013904223u;
+    size_t length = std::min<size_t>(size - i, (state >> 24u) + 1);
+    std::fill_n(result.begin() + static_cast<std::ptrdiff_t>(i), length,
+                result[i]);
+    i += length;
+  }
+  return result;
+}
+
+std::string encode(std::string const& data,
+                   size_t buffer_size = huffman::DEFAULT_BUFFER_SIZE /
+                                        huffman::BYTE_SIZE) {
+  huffman::encoder encoder_;
+  encoder_.set_buffer_size(buffer_size);
+  encoder_.add_chars(reinterpret_cast<uint8_t const*>(data.data()),
+                     data.size());
+  std::stringstream input(data);
+  std::stringstream output;
+  encoder_.encode(input, output);
+  return output.str();
+}
+
+// best of REPEATS runs, in seconds
+double measure(std::function<void()> const& function) {
+  double result = 0;
+  for (size_t i = 0; i < REPEATS; ++i) {
+    auto start = bench_clock::now();
+    function();
+    std::chrono::duration<double> duration = bench_clock::now() - start;
+    result = i == 0 ? duration.count() : std::min(result, duration.count());
+  }
+  return result;
+}
+
+double message_decode_latency(size_t message_size) {
+  constexpr size_t MESSAGES_COUNT = 2000;
+  std::vector<std::string> messages;
+  for (size_t i = 0; i < MESSAGES_COUNT; ++i) {
+    messages.push_back(encode(generate_data(message_size, i)));
+  }
+  std::string output;
+  double seconds = measure([&] {
+    for (std::string const& message : messages) {
+      std::stringstream input(message);
+      std::stringstream decoded;
+      huffman::decoder decoder_;
+      decoder_.decode(input, decoded);
+    }
+  });
+  return seconds * 1e9 / MESSAGES_COUNT;
+}
+
+// messages_kinds different messages are repeated, so some of them have
+// identical headers
+double message_batch_decode_latency(size_t message_size,
+                                    size_t messages_kinds) {
+  constexpr size_t MESSAGES_COUNT = 2000;
+  std::vector<std::string> encoded;
+  for (size_t i = 0; i < MESSAGES_COUNT; ++i) {
+    encoded.push_back(encode(generate_data(message_size, i % messages_kinds)));
+  }
+  std::string output(MESSAGES_COUNT * message_size, '\0');
+  std::vector<huffman::message> messages;
+  for (size_t i = 0; i < MESSAGES_COUNT; ++i) {
+    messages.push_back({reinterpret_cast<uint8_t const*>(encoded[i].data()),
+                        encoded[i].size(),
+                        reinterpret_cast<uint8_t*>(&output[i * message_size]),
+                        message_size});
+  }
+  double seconds =
+      measure([&] { huffman::message_decoder().decode(messages); });
+  return seconds * 1e9 / MESSAGES_COUNT;
+}
+
+// messages are coded by one codec and decoded by one session of it
+double session_decode_latency(size_t message_size) {
+  constexpr size_t MESSAGES_COUNT = 2000;
+  std::array<size_t, huffman::CHARS_COUNT> counts{};
+  std::vector<std::string> messages;
+  for (size_t i = 0; i < MESSAGES_COUNT; ++i) {
+    messages.push_back(generate_data(message_size, i));
+    for (char ch : messages.back()) {
+      ++counts[static_cast<uint8_t>(ch)];
+    }
+  }
+  auto shared = std::make_shared<huffman::codec const>(counts);
+  huffman::encode_session encoder_(shared);
+  std::vector<std::string> encoded(MESSAGES_COUNT);
+  for (size_t i = 0; i < MESSAGES_COUNT; ++i) {
+    encoder_.encode(reinterpret_cast<uint8_t const*>(messages[i].data()),
+                    message_size, encoded[i]);
+  }
+  std::string output(message_size, '\0');
+  huffman::decode_session decoder_(shared);
+  double seconds = measure([&] {
+    for (std::string const& message : encoded) {
+      decoder_.decode(reinterpret_cast<uint8_t const*>(message.data()),
+                      message.size(), reinterpret_cast<uint8_t*>(output.data()),
+                      output.size());
+    }
+  });
+  return seconds * 1e9 / MESSAGES_COUNT;
+}
+
+// binary-like data: all bytes occur, so tree has the most nodes
+std::string generate_bytes(size_t size, uint32_t seed) {
+  std::string result(size, '\0');
+  uint32_t state = seed;
+  for (char& ch : result) {
+    state = state * 1664525u + 1013904223u;
+    uint32_t value = state >> 16u;
+    ch = static_cast<char>((value * value >> 24u) ^ (seed * 7u));
+  }
+  return result;
+}
+
+// messages of codecs_count codecs with the biggest trees are decoded in
+// turn, so decoding tables of all of them compete for cache
+double tables_decode_throughput(size_t codecs_count) {
+  constexpr size_t MESSAGE_SIZE = 4096;
+  constexpr size_t ROUNDS = 64;
+  std::vector<huffman::decode_session> sessions;
+  std::vector<std::string> encoded(codecs_count);
+  for (size_t i = 0; i < codecs_count; ++i) {
+    std::string data = generate_bytes(MESSAGE_SIZE, static_cast<uint32_t>(i));
+    std::array<size_t, huffman::CHARS_COUNT> counts{};
+    counts.fill(1);
+    for (char ch : data) {
+      ++counts[static_cast<uint8_t>(ch)];
+    }
+    auto shared = std::make_shared<huffman::codec const>(counts);
+    huffman::encode_session(shared).encode(
+        reinterpret_cast<uint8_t const*>(data.data()), data.size(), encoded[i]);
+    sessions.emplace_back(shared);
+  }
+  std::string output(MESSAGE_SIZE, '\0');
+  double seconds = measure([&] {
+    for (size_t round = 0; round < ROUNDS; ++round) {
+      for (size_t i = 0; i < codecs_count; ++i) {
+        sessions[i].decode(reinterpret_cast<uint8_t const*>(encoded[i].data()),
+                           encoded[i].size(),
+                           reinterpret_cast<uint8_t*>(output.data()),
+                           output.size());
+      }
+    }
+  });
+  return static_cast<double>(MESSAGE_SIZE * codecs_count * ROUNDS) / seconds /
+         1e6;
+}
+
+// bytes of decoding tables of the biggest tree
+double tree_memory() {
+  return static_cast<double>(huffman::tree::memory_usage(huffman::CHARS_COUNT));
+}
+
+double decode_throughput(size_t size,
+                         size_t buffer_size = huffman::DEFAULT_BUFFER_SIZE /
+                                              huffman::BYTE_SIZE) {
+  std::string encoded = encode(generate_data(size, 1));
+  double seconds = measure([&] {
+    std::stringstream input(encoded);
+    std::stringstream decoded;
+    huffman::decoder decoder_;
+    decoder_.set_buffer_size(buffer_size);
+    decoder_.decode(input, decoded);
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// pattern search in decoded data, that is not stored
+double search_throughput(size_t size) {
+  std::string encoded = encode(generate_data(size, 1));
+  double seconds = measure([&] {
+    std::stringstream input(encoded);
+    huffman::search(input, "abcd", [](size_t) {});
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// decoding straight to preallocated output, decoded size is known
+double decode_to_memory_throughput(size_t size) {
+  std::string encoded = encode(generate_data(size, 1));
+  std::string decoded(size, '\0');
+  double seconds = measure([&] {
+    std::stringstream input(encoded);
+    huffman::decoder decoder_;
+    decoder_.decode(input, reinterpret_cast<uint8_t*>(decoded.data()),
+                    decoded.size());
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// decoded data is only counted and checksummed
+double verify_throughput(size_t size) {
+  std::string encoded = encode(generate_data(size, 1));
+  double seconds = measure([&] {
+    std::stringstream input(encoded);
+    huffman::decoder decoder_;
+    decoder_.verify(input);
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// one pass over data in memory with counts estimated from sample
+double sampled_encode_throughput(size_t size) {
+  std::string data = generate_data(size, 1);
+  auto input = reinterpret_cast<uint8_t const*>(data.data());
+  double seconds = measure([&] {
+    std::stringstream output;
+    huffman::encode_sampled(input, data.size(),
+                            huffman::sample_counts(input, data.size()),
+                            output, true);
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// runs are coded as framed member with or without run-length filter,
+// throughput is measured by size of original data
+double runs_decode_throughput(size_t size, char const* filter_name) {
+  std::string data = generate_runs(size, 1);
+  huffman::filter filter_;
+  if (filter_name != nullptr) {
+    filter_ = huffman::filter::parse(filter_name);
+  }
+  std::stringstream output;
+  huffman::encode_filtered(reinterpret_cast<uint8_t const*>(data.data()),
+                           data.size(), filter_, output);
+  std::string encoded = output.str();
+  std::string decoded(size, '\0');
+  double seconds = measure([&] {
+    std::stringstream input(encoded);
+    huffman::decoder decoder_;
+    decoder_.decode(input, reinterpret_cast<uint8_t*>(decoded.data()),
+                    decoded.size());
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+double runs_encode_throughput(size_t size, char const* filter_name) {
+  std::string data = generate_runs(size, 1);
+  huffman::filter filter_;
+  if (filter_name != nullptr) {
+    filter_ = huffman::filter::parse(filter_name);
+  }
+  double seconds = measure([&] {
+    std::stringstream output;
+    huffman::encode_filtered(reinterpret_cast<uint8_t const*>(data.data()),
+                             data.size(), filter_, output);
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// legacy stream decoded speculatively on all hardware threads
+double speculative_decode_throughput(size_t size) {
+  std::string encoded = encode(generate_data(size, 1));
+  double seconds = measure([&] {
+    std::stringstream decoded;
+    huffman::decode_speculative(
+        reinterpret_cast<uint8_t const*>(encoded.data()), encoded.size(),
+        decoded, std::thread::hardware_concurrency());
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+double encode_throughput(size_t size,
+                         size_t buffer_size = huffman::DEFAULT_BUFFER_SIZE /
+                                              huffman::BYTE_SIZE) {
+  std::string data = generate_data(size, 1);
+  double seconds = measure([&] { encode(data, buffer_size); });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// encoding to memory on all hardware threads, from memory with known counts
+double parallel_encode_throughput(size_t size) {
+  std::string data = generate_data(size, 1);
+  auto input = reinterpret_cast<uint8_t const*>(data.data());
+  double seconds = measure([&] {
+    huffman::encoder encoder_;
+    encoder_.add_chars(input, data.size());
+    encoder_.compile();
+    std::string output(encoder_.get_output_size(), '\0');
+    encoder_.encode(input, data.size(),
+                    reinterpret_cast<uint8_t*>(output.data()),
+                    std::thread::hardware_concurrency());
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// decoding without header by table, that is built at compile time
+double static_decode_throughput(size_t size) {
+  std::string data = generate_data(size, 1);
+  std::array<size_t, huffman::CHARS_COUNT> counts{};
+  for (char ch : data) {
+    ++counts[static_cast<uint8_t>(ch)];
+  }
+  std::array<uint8_t, huffman::CHARS_COUNT> lengths{};
+  huffman::tree::get_code_lengths(counts, lengths);
+  huffman::static_table table(lengths);
+  std::string encoded;
+  table.encode(reinterpret_cast<uint8_t const*>(data.data()), data.size(),
+               encoded);
+  double seconds = measure([&] {
+    std::string decoded;
+    table.decode(reinterpret_cast<uint8_t const*>(encoded.data()),
+                 encoded.size(), size, decoded);
+  });
+  return static_cast<double>(size) / seconds / 1e6;
+}
+
+// memory used by buffers and tables of decoder
+double decode_memory(size_t buffer_size) {
+  std::stringstream input(encode(generate_data(1024 * 1024, 1)));
+  std::stringstream decoded;
+  huffman::decoder decoder_;
+  decoder_.set_buffer_size(buffer_size);
+  decoder_.decode(input, decoded);
+  return static_cast<double>(decoder_.get_memory_usage());
+}
+
+std::vector<benchmark> benchmarks() {
+  constexpr size_t BIG_SIZE = 16 * 1024 * 1024;
+  std::vector<benchmark> result = {
+      {"message_decode_latency_64", "ns", [] { return message_decode_latency(64); }},
+      {"message_decode_latency_1024", "ns", [] { return message_decode_latency(1024); }},
+      {"message_batch_decode_latency_64", "ns", [] { return message_batch_decode_latency(64, 2000); }},
+      {"message_batch_decode_latency_64_repeated", "ns", [] { return message_batch_decode_latency(64, 16); }},
+      {"message_batch_decode_latency_1024", "ns", [] { return message_batch_decode_latency(1024, 2000); }},
+      {"session_decode_latency_64", "ns", [] { return session_decode_latency(64); }},
+      {"decode_throughput", "MB/s", [] { return decode_throughput(BIG_SIZE); }},
+      {"tables_decode_throughput_1", "MB/s", [] { return tables_decode_throughput(1); }},
+      {"tables_decode_throughput_64", "MB/s", [] { return tables_decode_throughput(64); }},
+      {"tree_memory", "bytes", [] { return tree_memory(); }},
+      {"search_throughput", "MB/s", [] { return search_throughput(BIG_SIZE); }},
+      {"decode_to_memory_throughput", "MB/s", [] { return decode_to_memory_throughput(BIG_SIZE); }},
+      {"verify_throughput", "MB/s", [] { return verify_throughput(BIG_SIZE); }},
+      {"speculative_decode_throughput", "MB/s", [] { return speculative_decode_throughput(BIG_SIZE); }},
+      {"encode_throughput", "MB/s", [] { return encode_throughput(BIG_SIZE); }},
+      {"sampled_encode_throughput", "MB/s", [] { return sampled_encode_throughput(BIG_SIZE); }},
+      {"runs_encode_throughput", "MB/s", [] { return runs_encode_throughput(BIG_SIZE, nullptr); }},
+      {"runs_encode_throughput_rle", "MB/s", [] { return runs_encode_throughput(BIG_SIZE, "rle"); }},
+      {"runs_decode_throughput", "MB/s", [] { return runs_decode_throughput(BIG_SIZE, nullptr); }},
+      {"runs_decode_throughput_rle", "MB/s", [] { return runs_decode_throughput(BIG_SIZE, "rle"); }},
+      {"parallel_encode_throughput", "MB/s", [] { return parallel_encode_throughput(BIG_SIZE); }},
+      {"static_decode_throughput", "MB/s", [] { return static_decode_throughput(BIG_SIZE); }},
+  };
+  // coding buffer sizes in bytes
+  for (size_t buffer_size : {256, 4096, 65536, 1024 * 1024}) {
+    std::string suffix = "_buffer_" + std::to_string(buffer_size);
+    result.push_back({"decode_throughput" + suffix, "MB/s",
+                      [=] { return decode_throughput(BIG_SIZE, buffer_size); }});
+    result.push_back({"encode_throughput" + suffix, "MB/s",
+                      [=] { return encode_throughput(BIG_SIZE, buffer_size); }});
+    result.push_back({"decode_memory" + suffix, "bytes",
+                      [=] { return decode_memory(buffer_size); }});
+  }
+  return result;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  for (benchmark const& bench : benchmarks()) {
+    bool selected = argc == 1;
+    for (int i = 1; i < argc; ++i) {
+      selected |= bench.name.rfind(argv[i], 0) == 0;
+    }
+    if (selected) {
+      std::cout << bench.name << " " << bench.run() << " " << bench.unit
+                << std::endl;
+    }
+  }
+}
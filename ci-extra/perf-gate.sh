@@ -0,0 +1,34 @@
+#!/bin/bash
+set -euo pipefail
+IFS=$' \t\n'
+
+# Usage: perf-gate.sh <build dir> <baseline file> [tolerance, % (10)]
+# Runs benchmarks listed in baseline (lines "name value unit", as printed by
+# huffman-bench) and fails if any of them is worse than baseline by more
+# than tolerance. MB/s is better when higher, other units when lower.
+# If baseline doesn't exist or UPDATE_BASELINE=1, it is written from all
+# benchmarks and the gate passes
+
+BENCH="$1/huffman-bench"
+BASELINE="$2"
+TOLERANCE="${3:-10}"
+
+if [ ! -f "${BASELINE}" ] || [ "${UPDATE_BASELINE:-0}" = "1" ]; then
+  "${BENCH}" | tee "${BASELINE}"
+  echo "Baseline is saved to ${BASELINE}"
+  exit 0
+fi
+
+# shellcheck disable=SC2046
+CURRENT=$("${BENCH}" $(cut -d ' ' -f 1 "${BASELINE}"))
+awk -v tolerance="${TOLERANCE}" '
+  NR == FNR { baseline[$1] = $2; next }
+  ($1 in baseline) {
+    change = baseline[$1] == 0 ? 0 : ($2 - baseline[$1]) / baseline[$1] * 100
+    worse = $3 == "MB/s" ? -change : change
+    status = worse > tolerance ? "REGRESSION" : "ok"
+    printf "%-45s %12g -> %12g %-6s %+7.1f%% %s\n", $1, baseline[$1], $2, $3, change, status
+    failed = failed || worse > tolerance
+  }
+  END { exit failed }
+' "${BASELINE}" - <<< "${CURRENT}"
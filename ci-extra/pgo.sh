@@ -0,0 +1,54 @@
+#!/bin/bash
+set -euo pipefail
+IFS=$' \t\n'
+
+# Builds cmake-build-PGO of repository in two passes, from any directory:
+# instrumented build is trained by compressing and decompressing files from
+# arguments (files or directories, repository sources by default), then it
+# is rebuilt with collected profile. Extra configure arguments are taken
+# from CMAKE_ARGS
+
+SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+SOURCE_DIR="$( cd "${SCRIPT_DIR}/.." && pwd )"
+CMAKE_ARGS=${CMAKE_ARGS:-"-DCMAKE_TOOLCHAIN_FILE=../vcpkg/scripts/buildsystems/vcpkg.cmake"}
+BUILD_DIR="${SOURCE_DIR}/cmake-build-PGO"
+PROFILE_DIR="${BUILD_DIR}/pgo-profile"
+TOOL="${BUILD_DIR}/huffman-tool"
+
+if [ $# -eq 0 ]; then
+  set -- "${SOURCE_DIR}/library" "${SOURCE_DIR}/README.md"
+fi
+
+rm -rf "${PROFILE_DIR}"
+# shellcheck disable=SC2086
+cmake ${CMAKE_ARGS} --preset PGO -DPGO=GENERATE "-DPGO_PROFILE_DIR=${PROFILE_DIR}" -S "${SOURCE_DIR}" -B "${BUILD_DIR}"
+cmake --build "${BUILD_DIR}" --target huffman-tool
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+mkdir "${WORK_DIR}/corpus"
+for path in "$@"; do
+  cp -r "${path}" "${WORK_DIR}/corpus/"
+done
+# binary data along with text
+cp "${TOOL}" "${WORK_DIR}/corpus/"
+
+while IFS= read -r -d '' file; do
+  for flags in "" "--legacy" "--adaptive" "--no-checksum"; do
+    # shellcheck disable=SC2086
+    "${TOOL}" -c ${flags} --input "${file}" --output "${WORK_DIR}/compressed" > /dev/null
+    "${TOOL}" -d --input "${WORK_DIR}/compressed" --output "${WORK_DIR}/decompressed" > /dev/null
+    cmp -s "${file}" "${WORK_DIR}/decompressed"
+  done
+done < <(find "${WORK_DIR}/corpus" -type f -print0)
+"${TOOL}" -c -b --block-size 65536 --input "${WORK_DIR}/corpus" --output "${WORK_DIR}/batch" > /dev/null
+"${TOOL}" -d -b --input "${WORK_DIR}/batch" --output "${WORK_DIR}/batch-decompressed" > /dev/null
+
+# clang writes raw profiles, which must be merged
+if compgen -G "${PROFILE_DIR}/*.profraw" > /dev/null; then
+  llvm-profdata merge -output="${PROFILE_DIR}/default.profdata" "${PROFILE_DIR}"/*.profraw
+fi
+
+# shellcheck disable=SC2086
+cmake ${CMAKE_ARGS} --preset PGO -DPGO=USE "-DPGO_PROFILE_DIR=${PROFILE_DIR}" -S "${SOURCE_DIR}" -B "${BUILD_DIR}"
+cmake --build "${BUILD_DIR}"
@@ -0,0 +1,51 @@
+#!/bin/bash
+set -euo pipefail
+IFS=$' \t\n'
+
+# Usage: serve-latency.sh <build dir> [requests count (200)] [file]
+# Compares latency of compressing and decompressing a small file (README.md
+# by default) by new process of the tool and by compression server through
+# --client, with one file per request and with all files in one request.
+# Prints lines "name value unit", as huffman-bench does, so output can be
+# used as perf-gate.sh baseline
+
+SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+TOOL="$1/huffman-tool"
+COUNT="${2:-200}"
+FILE="$(realpath "${3:-${SCRIPT_DIR}/../README.md}")"
+
+WORK_DIR=$(mktemp -d)
+SOCKET="${WORK_DIR}/huffman.sock"
+"${TOOL}" --serve "${SOCKET}" &
+SERVER_PID=$!
+trap '"${TOOL}" --stop "${SOCKET}" 2> /dev/null || kill "${SERVER_PID}"; rm -rf "${WORK_DIR}"' EXIT
+while [ ! -S "${SOCKET}" ]; do
+  sleep 0.01
+done
+
+# average time of request in microseconds, requests are run by "$@"
+measure() {
+  local start end
+  start=$(date +%s%N)
+  for _ in $(seq "${COUNT}"); do
+    "$@" -c --input "${FILE}" --output "${WORK_DIR}/compressed" > /dev/null
+    "$@" -d --input "${WORK_DIR}/compressed" --output "${WORK_DIR}/decompressed" > /dev/null
+  done
+  end=$(date +%s%N)
+  cmp -s "${FILE}" "${WORK_DIR}/decompressed"
+  echo $(( (end - start) / (2 * COUNT) / 1000 ))
+}
+
+echo "process_request_latency $(measure "${TOOL}") us"
+echo "served_request_latency $(measure "${TOOL}" --client "${SOCKET}") us"
+
+mkdir "${WORK_DIR}/files"
+for i in $(seq "${COUNT}"); do
+  cp "${FILE}" "${WORK_DIR}/files/${i}"
+done
+start=$(date +%s%N)
+"${TOOL}" --client "${SOCKET}" -c -b --input "${WORK_DIR}/files" --output "${WORK_DIR}/batch" > /dev/null
+"${TOOL}" --client "${SOCKET}" -d -b --input "${WORK_DIR}/batch" --output "${WORK_DIR}/batch-decompressed" > /dev/null
+end=$(date +%s%N)
+diff -r "${WORK_DIR}/files" "${WORK_DIR}/batch-decompressed" > /dev/null
+echo "served_batch_request_latency $(( (end - start) / (2 * COUNT) / 1000 )) us"
@@ -0,0 +1,10 @@
+#include "engines.h"
+#include <cstddef>
+#include <cstdint>
+
+// Arbitrary bytes as compressed stream: engines may reject them, but must
+// not crash and must agree with each other
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size) {
+  fuzz::decode_all(data, size);
+  return 0;
+}
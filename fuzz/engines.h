@@ -0,0 +1,98 @@
+#pragma once
+
+#include "decoder.h"
+#include "messages.h"
+#include "speculative.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Every way to decode a stream, that fuzzers compare with each other.
+// nullopt means that engine rejected the input
+namespace fuzz {
+inline std::optional<std::string> decode_stream(uint8_t const* data,
+                                                size_t size,
+                                                size_t buffer_size) {
+  std::stringstream input(
+      std::string(reinterpret_cast<char const*>(data), size));
+  std::stringstream output;
+  huffman::decoder decoder_;
+  decoder_.set_buffer_size(buffer_size);
+  try {
+    decoder_.decode(input, output);
+  } catch (std::runtime_error const&) {
+    return std::nullopt;
+  }
+  return output.str();
+}
+
+inline std::optional<std::string> decode_message(uint8_t const* data,
+                                                 size_t size) {
+  // every code has at least one bit
+  std::string output(size * huffman::BYTE_SIZE, '\0');
+  huffman::message message_{data, size,
+                            reinterpret_cast<uint8_t*>(output.data()),
+                            output.size()};
+  huffman::message_decoder decoder_;
+  try {
+    output.resize(decoder_.decode(message_));
+  } catch (std::runtime_error const&) {
+    return std::nullopt;
+  }
+  return output;
+}
+
+inline std::optional<std::string> decode_speculative(uint8_t const* data,
+                                                     size_t size) {
+  std::stringstream output;
+  try {
+    // the smallest chunks, so short streams are split too
+    huffman::decode_speculative(data, size, output, 2, 1);
+  } catch (std::runtime_error const&) {
+    return std::nullopt;
+  }
+  return output.str();
+}
+
+// size of decoded data, that is not stored
+inline std::optional<size_t> verify(uint8_t const* data, size_t size) {
+  std::stringstream input(
+      std::string(reinterpret_cast<char const*>(data), size));
+  huffman::decoder decoder_;
+  try {
+    return decoder_.verify(input).second;
+  } catch (std::runtime_error const&) {
+    return std::nullopt;
+  }
+}
+
+// Stream decoder with different buffer sizes must give the same result,
+// message decoder accepts only single members, but if it succeeds, result
+// must be the same. Speculative decoder must give the same result for
+// legacy streams. Verification must accept the same streams. Returns result
+// of stream decoder
+inline std::optional<std::string> decode_all(uint8_t const* data,
+                                             size_t size) {
+  std::optional<std::string> result = decode_stream(data, size, 4096);
+  if (decode_stream(data, size, 1) != result) {
+    __builtin_trap();
+  }
+  std::optional<std::string> message_result = decode_message(data, size);
+  if (message_result.has_value() && message_result != result) {
+    __builtin_trap();
+  }
+  if (size != 0 && data[0] != 0 &&
+      decode_speculative(data, size) != result) {
+    __builtin_trap();
+  }
+  std::optional<size_t> verified = verify(data, size);
+  if (verified.has_value() != result.has_value() ||
+      (verified.has_value() && *verified != result->size())) {
+    __builtin_trap();
+  }
+  return result;
+}
+} // namespace fuzz
@@ -0,0 +1,33 @@
+#include "decoder.h"
+#include "frame.h"
+#include "table_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+// Frame header and legacy header with tree traversal
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size) {
+  try {
+    huffman::frame_header header = huffman::frame_header::parse(data, size);
+    if (header.header_size() > size ||
+        (header.flags & ~huffman::FRAME_KNOWN_FLAGS) != 0) {
+      __builtin_trap();
+    }
+  } catch (std::runtime_error const&) {
+  }
+
+  if (size == 0 || data[0] == 0 ||
+      huffman::decoder::get_header_size(data[0]) > size) {
+    return 0;
+  }
+  // small capacity, so trees are evicted too
+  static huffman::table_cache cache(64 * 1024);
+  try {
+    auto tree_ = cache.get(data);
+    if (tree_ == nullptr || cache.get(data) == nullptr) {
+      __builtin_trap();
+    }
+  } catch (std::runtime_error const&) {
+  }
+  return 0;
+}
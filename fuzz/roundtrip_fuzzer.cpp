@@ -0,0 +1,82 @@
+#include "encoder.h"
+#include "engines.h"
+#include "filter.h"
+#include "frame.h"
+#include "static_table.h"
+#include "tree.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace {
+std::string encode(std::string const& input, uint8_t mode) {
+  huffman::encoder encoder_;
+  encoder_.add_chars(reinterpret_cast<uint8_t const*>(input.data()),
+                     input.size());
+  std::stringstream encoder_input(input);
+  std::stringstream output;
+  // higher bits of mode select filter of framed member and its width
+  huffman::filter filter_;
+  filter_.type = static_cast<huffman::filter_type>(mode / 3 % 4);
+  if (filter_.type != huffman::filter_type::rle) {
+    filter_.width = static_cast<uint8_t>(mode / 12 % 8 + 1);
+  }
+  if (mode % 3 == 0) {
+    encoder_.encode(encoder_input, output);
+  } else if (filter_.type != huffman::filter_type::none) {
+    huffman::encode_filtered(reinterpret_cast<uint8_t const*>(input.data()),
+                             input.size(), filter_, output,
+                             mode % 3 == 1 ? huffman::FRAME_FLAG_CHECKSUM
+                                           : 0);
+  } else {
+    encoder_.encode_framed(encoder_input, output,
+                           mode % 3 == 1 ? huffman::FRAME_FLAG_CHECKSUM : 0);
+  }
+  return output.str();
+}
+
+void check_static_table(std::string const& input) {
+  std::array<size_t, huffman::CHARS_COUNT> counts{};
+  for (char ch : input) {
+    ++counts[static_cast<uint8_t>(ch)];
+  }
+  std::array<uint8_t, huffman::CHARS_COUNT> lengths{};
+  huffman::tree::get_code_lengths(counts, lengths);
+  for (uint8_t length : lengths) {
+    if (length > huffman::static_table::MAX_CODE_SIZE) {
+      return;
+    }
+  }
+  huffman::static_table table(lengths);
+  auto data = reinterpret_cast<uint8_t const*>(input.data());
+  std::string encoded;
+  table.encode(data, input.size(), encoded);
+  std::string decoded;
+  table.decode(reinterpret_cast<uint8_t const*>(encoded.data()),
+               encoded.size(), input.size(), decoded);
+  if (decoded != input) {
+    __builtin_trap();
+  }
+}
+} // namespace
+
+// First byte selects format and filter, the rest is data, that must be
+// decoded back by every engine
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  std::string input(reinterpret_cast<char const*>(data) + 1, size - 1);
+  std::string encoded = encode(input, data[0]);
+  auto result = fuzz::decode_all(
+      reinterpret_cast<uint8_t const*>(encoded.data()), encoded.size());
+  if (result != input) {
+    __builtin_trap();
+  }
+  if (input.size() > 1) {
+    check_static_table(input);
+  }
+  return 0;
+}
@@ -0,0 +1,43 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Replays inputs of fuzz target without libFuzzer, for compilers other than
+// clang. Arguments are files or directories with files
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size);
+
+namespace {
+void run(std::filesystem::path const& path) {
+  std::ifstream input(path, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(input)),
+                   std::istreambuf_iterator<char>());
+  LLVMFuzzerTestOneInput(reinterpret_cast<uint8_t const*>(data.data()),
+                         data.size());
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t count = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::filesystem::path path(argv[i]);
+    if (std::filesystem::is_directory(path)) {
+      for (auto const& entry :
+           std::filesystem::recursive_directory_iterator(path)) {
+        if (entry.is_regular_file()) {
+          run(entry.path());
+          ++count;
+        }
+      }
+    } else {
+      run(path);
+      ++count;
+    }
+  }
+  std::cout << "Executed " << count << " inputs" << std::endl;
+  return 0;
+}
@@ -1,25 +1,131 @@
+#include "batch.h"
+#include "crc32c.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "filter.h"
+#include "frame.h"
+#include "mapped_file.h"
+#include "partition.h"
+#include "sampling.h"
+#include "search.h"
+#include "server.h"
+#include "speculative.h"
+#include <chrono>
+#include <cmath>
 #include <cxxopts.hpp>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace {
 constexpr int MAX_PERCENTS = 100;
+// exit code when file is not compressed because of --threshold
+constexpr int SKIPPED_EXIT_CODE = 2;
+// exit code when --grep finds nothing
+constexpr int NOT_FOUND_EXIT_CODE = 3;
+
+// --serve and --stop take neither files nor mode
+bool is_server_command(cxxopts::ParseResult const& result) {
+  return result.count("serve") + result.count("stop") != 0;
+}
+
+bool correct_files(cxxopts::ParseResult const& result) {
+  if (is_server_command(result)) {
+    return result.count("input") + result.count("output") == 0;
+  }
+  bool has_output =
+      result.count("estimate") + result.count("grep") + result.count("test") ==
+      0;
+  return result.count("input") == 1 &&
+         result.count("output") == (has_output ? 1 : 0);
+}
+
+bool correct_mode(cxxopts::ParseResult const& result) {
+  if (is_server_command(result)) {
+    return result.count("serve") + result.count("stop") == 1 &&
+           result.count("compress") + result.count("decompress") +
+                   result.count("estimate") + result.count("client") +
+                   result.count("batch") ==
+               0;
+  }
+  // server processes files as batch mode
+  return result.count("compress") + result.count("decompress") +
+                 result.count("estimate") + result.count("grep") +
+                 result.count("concat") + result.count("test") ==
+             1 &&
+         result.count("test") + result.count("client") <= 1 &&
+         (result.count("batch") + result.count("client") == 0 ||
+          result.count("estimate") + result.count("adaptive") +
+                  result.count("legacy") + result.count("grep") +
+                  result.count("concat") + result.count("append") ==
+              0) &&
+         (result.count("append") == 0 ||
+          (result.count("compress") == 1 && result.count("legacy") == 0)) &&
+         result.count("legacy") + result.count("adaptive") <= 1 &&
+         result.count("checksum") + result.count("no-checksum") <= 1 &&
+         (result.count("sample") == 0 ||
+          result.count("estimate") + result.count("adaptive") +
+                  result.count("batch") + result.count("client") ==
+              0) &&
+         (result.count("filter") == 0 ||
+          (result.count("compress") + result.count("estimate") == 1 &&
+           result.count("legacy") + result.count("adaptive") +
+                   result.count("sample") + result.count("batch") +
+                   result.count("client") ==
+               0));
+}
 
 void help(cxxopts::Options const& options, cxxopts::ParseResult const& result) {
   std::cout << options.help() << std::endl;
-  std::cout << "In decompression mode, if input file was not compressed by "
-               "that tool than an error might occur"
+  std::cout << "Compressed files start with format signature and version, "
+               "files of unknown format or version are rejected. Files "
+               "compressed with --legacy have no signature, if such input "
+               "file was not compressed by that tool than an error might "
+               "occur. Files compressed without --no-checksum are checked "
+               "for corruption"
+            << std::endl;
+  std::cout << "Compressed file consists of members, so --append and "
+               "--concat add members to the end of output, that must be "
+               "compressed without --legacy, without decoding it"
+            << std::endl;
+  std::cout << "If file is skipped because of --threshold, exit code is "
+            << SKIPPED_EXIT_CODE << std::endl;
+  std::cout << "--grep prints offsets of all occurrences of pattern in "
+               "decompressed file, one per line, without writing it. If "
+               "there are none, exit code is "
+            << NOT_FOUND_EXIT_CODE << std::endl;
+  std::cout << "In batch mode input is a directory or a file with list of "
+               "paths, one per line, output is a directory where input tree "
+               "is mirrored. Compressed files get .huff extension, --legacy "
+               "can't be used"
+            << std::endl;
+  std::cout << "Server started with --serve keeps threads and decoding "
+               "tables between requests, --client sends it a request "
+               "instead of processing files itself, the same way as in "
+               "batch mode. --stop stops it"
             << std::endl;
-  if (result.count("output") != 1 || result.count("input") != 1) {
-    std::cerr << "Both output and input files must be passed as arguments"
+  if (!correct_files(result)) {
+    std::cerr << "Input file and, if not in estimation mode, output file "
+                 "must be passed as arguments"
               << std::endl;
   }
-  if (result.count("compress") + result.count("decompress") != 1) {
-    std::cerr << "Exactly one of --compress and --decompress options must "
-                 "be passed"
+  if (!correct_mode(result)) {
+    std::cerr << "Exactly one of --compress, --decompress, --estimate, "
+                 "--grep, --concat and --test options must be passed, "
+                 "--test can't be used with --client, --estimate, "
+                 "--grep, --concat, --append, --adaptive and --legacy can't "
+                 "be used in batch mode and with --client, --append can be "
+                 "used only in compression without --legacy, "
+                 "--legacy can't be used with --adaptive, --sample can be "
+                 "used only in compression of one file, --filter can be "
+                 "used only in compression and estimation of one file "
+                 "without --legacy, --adaptive and --sample, --serve and "
+                 "--stop can't be used with other modes"
               << std::endl;
   }
   if (!result.unmatched().empty()) {
@@ -48,6 +154,31 @@ void ensure_open(std::ofstream const& stream) {
   }
 }
 
+// output is appended to only if it is empty or complete framed stream
+std::ofstream open_output(std::string const& filename, bool append) {
+  if (append) {
+    std::ifstream existing(filename, std::ios::binary);
+    if (existing.is_open() &&
+        existing.peek() != std::char_traits<char>::eof()) {
+      try {
+        huffman::read_complete_members(existing);
+      } catch (std::runtime_error const& e) {
+        error("Appending", e.what());
+      }
+    }
+  }
+  // existing file is opened without std::ios::app, so output stays seekable
+  std::ofstream result(filename, append && std::filesystem::exists(filename)
+                                     ? std::ios::binary | std::ios::in |
+                                           std::ios::out
+                                     : std::ios::binary);
+  ensure_open(result);
+  if (append) {
+    result.seekp(0, std::ios::end);
+  }
+  return result;
+}
+
 constexpr std::array<char const*, 4> SIZES = {" bytes", " KB", " MB", " GB"};
 constexpr double size_factor = 1024;
 
@@ -95,6 +226,518 @@ void show_compression_rate(
     std::cout << std::endl;
   }
 }
+// legacy streams have no frame
+bool is_legacy(cxxopts::ParseResult const& result) {
+  return result.count("legacy") != 0;
+}
+uint8_t frame_flags(cxxopts::ParseResult const& result) {
+  return result.count("no-checksum") == 0 ? huffman::FRAME_FLAG_CHECKSUM : 0;
+}
+size_t compressed_size(huffman::encoder const& encoder_,
+                       cxxopts::ParseResult const& result) {
+  size_t size = encoder_.get_output_size();
+  if (!is_legacy(result)) {
+    size += huffman::frame_overhead(frame_flags(result));
+  }
+  return size;
+}
+bool exceeds_threshold(size_t compressed_size, size_t decompressed_size,
+                       cxxopts::ParseResult const& result) {
+  return result.count("threshold") != 0 &&
+         static_cast<double>(compressed_size) >
+             result["threshold"].as<double>() *
+                 static_cast<double>(decompressed_size);
+}
+void show_estimate(std::string const& input_filename,
+                   huffman::encoder const& encoder_, size_t output_size) {
+  size_t input_size = encoder_.get_input_size();
+  double entropy = encoder_.get_entropy();
+  std::cout << "Input file: " << input_filename
+            << ", size: " << show_size(input_size)
+            << "\nCompressed size: " << show_size(output_size)
+            << "\nEntropy: " << entropy << " bits per byte, lower bound: "
+            << show_size(static_cast<size_t>(
+                   std::ceil(entropy * static_cast<double>(input_size) /
+                             huffman::BYTE_SIZE)))
+            << std::endl;
+  show_compression_rate(output_size, input_size, true);
+}
+void show_stats(huffman::stats const& stats_, char const* mode,
+                std::chrono::steady_clock::time_point start) {
+  auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::cout << "{\"mode\": \"" << mode << "\""
+            << ", \"input_bytes\": " << stats_.input_bytes
+            << ", \"output_bytes\": " << stats_.output_bytes
+            << ", \"symbols\": " << stats_.symbols
+            << ", \"buffer_flushes\": " << stats_.buffer_flushes
+            << ", \"time_ns\": {\"counting\": " << stats_.counting_time
+            << ", \"tree_build\": " << stats_.tree_build_time
+            << ", \"header\": " << stats_.header_time
+            << ", \"coding\": " << stats_.coding_time
+            << ", \"io\": " << stats_.io_time
+            << ", \"total\": " << total.count() << "}}" << std::endl;
+}
+// input is encoded by several threads straight to memory mapped output,
+// output is the same as of serial encoding
+void encode_parallel(huffman::encoder& encoder_,
+                     std::string const& input_filename,
+                     std::string const& output_filename, size_t output_size,
+                     cxxopts::ParseResult const& result) {
+  huffman::mapped_file input(input_filename);
+  huffman::mapped_output output(output_filename, output_size);
+  uint8_t* payload = output.data();
+  huffman::frame_header header;
+  if (!is_legacy(result)) {
+    header.flags = frame_flags(result);
+    header.original_size = input.size();
+    header.payload_size = encoder_.get_output_size();
+    std::ostringstream header_stream;
+    header.write(header_stream);
+    std::string header_bytes = header_stream.str();
+    payload = std::copy(header_bytes.begin(), header_bytes.end(), payload);
+  }
+  encoder_.encode(input.data(), input.size(), payload,
+                  result["threads"].as<size_t>());
+  if (!is_legacy(result) && header.has_flag(huffman::FRAME_FLAG_CHECKSUM)) {
+    huffman::crc32c checksum;
+    checksum.update(input.data(), input.size());
+    std::ostringstream trailer;
+    huffman::write_number(trailer, checksum.value(),
+                          huffman::FRAME_TRAILER_SIZE);
+    std::string trailer_bytes = trailer.str();
+    std::copy(trailer_bytes.begin(), trailer_bytes.end(),
+              output.data() + output_size - trailer_bytes.size());
+  }
+  output.flush();
+}
+// framed streams know their decoded size, so they are decoded straight to
+// memory mapped output file. Legacy stream is decoded speculatively by
+// several threads, if they are given. Stats of decoding are written to
+// stats_ if it is given
+std::pair<size_t, size_t> decode_file(huffman::decoder& decoder_,
+                                      std::ifstream& input,
+                                      std::string const& input_filename,
+                                      std::string const& output_filename,
+                                      size_t threads_count,
+                                      huffman::stats* stats_) {
+  std::vector<huffman::frame_member> members = huffman::read_members(input);
+  input.clear();
+  input.seekg(0);
+  if (members.empty()) {
+    std::ofstream output(output_filename, std::ios::binary);
+    ensure_open(output);
+    if (threads_count > 1) {
+      huffman::mapped_file mapped(input_filename);
+      return huffman::decode_speculative(mapped.data(), mapped.size(), output,
+                                         threads_count,
+                                         huffman::SPECULATIVE_CHUNK_SIZE,
+                                         stats_);
+    }
+    auto sizes = decoder_.decode(input, output);
+    if (stats_ != nullptr) {
+      *stats_ = decoder_.get_stats();
+    }
+    return sizes;
+  }
+  // original sizes are bounded by payloads, which are read by read_members
+  size_t output_size = 0;
+  for (huffman::frame_member const& member : members) {
+    output_size += member.header.original_size;
+  }
+  try {
+    huffman::mapped_output output(output_filename, output_size);
+    decoder_.decode(input, output.data(), output.size());
+    output.flush();
+  } catch (std::runtime_error const&) {
+    // output of declared size isn't left behind for incorrect stream
+    std::error_code ignored;
+    std::filesystem::remove(output_filename, ignored);
+    throw;
+  }
+  if (stats_ != nullptr) {
+    *stats_ = decoder_.get_stats();
+  }
+  huffman::frame_member const& last = members.back();
+  return {last.offset + last.size(), output_size};
+}
+// counts are estimated from sample, so input is read once. Ratio of size
+// lost against exact counts is shown with --info
+int compress_sampled(cxxopts::ParseResult const& result,
+                     std::string const& input_filename, bool show_info) {
+  std::unique_ptr<huffman::mapped_file> input;
+  try {
+    input = std::make_unique<huffman::mapped_file>(input_filename);
+  } catch (std::runtime_error const& e) {
+    error("I/O", e.what());
+  }
+  std::array<size_t, huffman::CHARS_COUNT> counts =
+      huffman::sample_counts(input->data(), input->size());
+  size_t estimated_size =
+      huffman::encoder::get_output_size(counts) +
+      (is_legacy(result) ? 0 : huffman::frame_overhead(frame_flags(result)));
+  if (exceeds_threshold(estimated_size, input->size(), result)) {
+    std::cout << "Skipped " << input_filename
+              << ": compressed size would be about "
+              << show_size(estimated_size) << " of "
+              << show_size(input->size()) << std::endl;
+    return SKIPPED_EXIT_CODE;
+  }
+  std::string output_filename = result["output"].as<std::string>();
+  std::ofstream output_stream =
+      open_output(output_filename, result.count("append") != 0);
+  huffman::sampled_result sampled;
+  try {
+    sampled = huffman::encode_sampled(input->data(), input->size(), counts,
+                                      output_stream, is_legacy(result),
+                                      frame_flags(result));
+  } catch (std::runtime_error const& e) {
+    error("Encoding", e.what());
+  }
+  if (show_info) {
+    show_files_info(input_filename, input->size(), output_filename,
+                    sampled.output_size);
+    show_compression_rate(sampled.output_size, input->size(), true);
+    if (sampled.missed_chars != 0) {
+      std::cout << "Sample missed " << sampled.missed_chars
+                << " chars, they were written by escape codes" << std::endl;
+    }
+    if (sampled.members_count != 0) {
+      std::cout << "Output isn't seekable, it was written by "
+                << sampled.members_count << " framed members" << std::endl;
+    }
+    double lost = static_cast<double>(sampled.output_size) /
+                      static_cast<double>(sampled.exact_output_size) -
+                  1;
+    std::cout << "Sampling lost " << lost * MAX_PERCENTS
+              << "% against exact counts, " << show_size(sampled.output_size)
+              << " instead of " << show_size(sampled.exact_output_size)
+              << std::endl;
+  }
+  return 0;
+}
+// members of input are copied to the end of output as they are
+int concat(cxxopts::ParseResult const& result,
+           std::string const& input_filename, bool show_info) {
+  std::ifstream input(input_filename, std::ios::binary);
+  ensure_open(input);
+  std::string output_filename = result["output"].as<std::string>();
+  std::ofstream output = open_output(output_filename, true);
+  uint64_t size = 0;
+  try {
+    size = huffman::append_members(input, output);
+  } catch (std::runtime_error const& e) {
+    error("Appending", e.what());
+  }
+  if (show_info) {
+    std::cout << "Appended " << show_size(size) << " of " << input_filename
+              << " to " << output_filename << std::endl;
+  }
+  return 0;
+}
+int grep(cxxopts::ParseResult const& result,
+         std::string const& input_filename, bool show_info) {
+  std::ifstream input(input_filename, std::ios::binary);
+  ensure_open(input);
+  size_t count = 0;
+  try {
+    count = huffman::search(input, result["grep"].as<std::string>(),
+                            [](size_t offset) {
+                              std::cout << offset << '\n';
+                            });
+  } catch (std::runtime_error const& e) {
+    error("Decoding", e.what());
+  }
+  if (show_info) {
+    std::cout << count << " matches in " << input_filename << std::endl;
+  }
+  return count != 0 ? 0 : NOT_FOUND_EXIT_CODE;
+}
+// whole file is filtered and coded in memory
+int compress_filtered(cxxopts::ParseResult const& result,
+                      std::string const& input_filename, bool estimate,
+                      bool show_info) {
+  huffman::filter filter_;
+  try {
+    filter_ = huffman::filter::parse(result["filter"].as<std::string>());
+  } catch (std::runtime_error const& e) {
+    error("Arguments", e.what());
+  }
+  std::unique_ptr<huffman::mapped_file> input;
+  try {
+    input = std::make_unique<huffman::mapped_file>(input_filename);
+  } catch (std::runtime_error const& e) {
+    error("I/O", e.what());
+  }
+  std::ostringstream encoded;
+  size_t output_size = huffman::encode_filtered(
+      input->data(), input->size(), filter_, encoded, frame_flags(result));
+  bool skip = exceeds_threshold(output_size, input->size(), result);
+  if (estimate) {
+    std::cout << "Input file: " << input_filename
+              << ", size: " << show_size(input->size())
+              << "\nCompressed size: " << show_size(output_size)
+              << " with filter" << std::endl;
+    show_compression_rate(output_size, input->size(), true);
+    if (skip) {
+      std::cout << "File would be skipped with given threshold" << std::endl;
+    }
+    return 0;
+  }
+  if (skip) {
+    std::cout << "Skipped " << input_filename
+              << ": compressed size would be " << show_size(output_size)
+              << " of " << show_size(input->size()) << std::endl;
+    return SKIPPED_EXIT_CODE;
+  }
+  std::string output_filename = result["output"].as<std::string>();
+  std::ofstream output_stream =
+      open_output(output_filename, result.count("append") != 0);
+  std::string const& data = encoded.str();
+  output_stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+  if (show_info) {
+    show_files_info(input_filename, input->size(), output_filename,
+                    output_size);
+    show_compression_rate(output_size, input->size(), true);
+  }
+  return 0;
+}
+int compress_adaptive(cxxopts::ParseResult const& result,
+                      std::string const& input_filename, bool estimate,
+                      bool show_info) {
+  std::unique_ptr<huffman::mapped_file> input;
+  try {
+    input = std::make_unique<huffman::mapped_file>(input_filename);
+  } catch (std::runtime_error const& e) {
+    error("I/O", e.what());
+  }
+  std::vector<huffman::block> blocks =
+      huffman::partition(input->data(), input->size());
+  size_t output_size = 0;
+  for (huffman::block const& block_ : blocks) {
+    // blocks are sized with checksum
+    output_size += block_.encoded_size -
+                   huffman::frame_overhead(huffman::FRAME_FLAG_CHECKSUM) +
+                   huffman::frame_overhead(frame_flags(result));
+  }
+  bool skip = exceeds_threshold(output_size, input->size(), result);
+  if (estimate) {
+    std::cout << "Input file: " << input_filename
+              << ", size: " << show_size(input->size())
+              << "\nCompressed size: " << show_size(output_size) << " in "
+              << blocks.size() << " blocks" << std::endl;
+    show_compression_rate(output_size, input->size(), true);
+    if (skip) {
+      std::cout << "File would be skipped with given threshold" << std::endl;
+    }
+    return 0;
+  }
+  if (skip) {
+    std::cout << "Skipped " << input_filename
+              << ": compressed size would be " << show_size(output_size)
+              << " of " << show_size(input->size()) << std::endl;
+    return SKIPPED_EXIT_CODE;
+  }
+  std::string output_filename = result["output"].as<std::string>();
+  std::ofstream output_stream =
+      open_output(output_filename, result.count("append") != 0);
+  huffman::encode_blocks(input->data(), blocks, output_stream,
+                         frame_flags(result));
+  if (show_info) {
+    show_files_info(input_filename, input->size(), output_filename,
+                    output_size);
+    show_compression_rate(output_size, input->size(), true);
+  }
+  return 0;
+}
+std::filesystem::path mirrored_path(std::filesystem::path const& path) {
+  // path from list can be absolute or go up, output must stay inside
+  // output directory
+  std::filesystem::path result;
+  for (std::filesystem::path const& part :
+       path.lexically_normal().relative_path()) {
+    if (part != "..") {
+      result /= part;
+    }
+  }
+  return result;
+}
+// input is directory or list of files, add is called with every file and
+// its path relative to input
+template <typename F>
+void for_each_input(std::filesystem::path const& input, F const& add) {
+  if (std::filesystem::is_directory(input)) {
+    for (auto const& entry :
+         std::filesystem::recursive_directory_iterator(input)) {
+      if (entry.is_regular_file()) {
+        add(entry.path(), entry.path().lexically_relative(input));
+      }
+    }
+  } else {
+    std::ifstream list(input);
+    ensure_open(list);
+    std::string line;
+    while (std::getline(list, line)) {
+      if (!line.empty()) {
+        add(line, mirrored_path(line));
+      }
+    }
+  }
+}
+std::vector<huffman::file_pair> batch_files(std::filesystem::path const& input,
+                                            std::filesystem::path const& output,
+                                            bool compress) {
+  std::vector<huffman::file_pair> result;
+  for_each_input(input, [&](std::filesystem::path const& file,
+                            std::filesystem::path const& relative_path) {
+    std::filesystem::path output_file = output / relative_path;
+    if (compress) {
+      output_file += ".huff";
+    } else if (output_file.extension() == ".huff") {
+      output_file.replace_extension();
+    } else {
+      output_file += ".out";
+    }
+    std::filesystem::create_directories(output_file.parent_path());
+    result.emplace_back(file, output_file);
+  });
+  return result;
+}
+template <typename Coder>
+void set_memory_options(Coder& coder, cxxopts::ParseResult const& result) {
+  if (result.count("buffer-size") != 0) {
+    coder.set_buffer_size(result["buffer-size"].as<size_t>());
+  }
+  if (result.count("memory-limit") != 0) {
+    coder.set_memory_limit(result["memory-limit"].as<size_t>());
+  }
+}
+
+huffman::batch_options get_batch_options(cxxopts::ParseResult const& result) {
+  huffman::batch_options options;
+  if (result.count("threads") != 0) {
+    options.threads = result["threads"].as<size_t>();
+  }
+  if (result.count("block-size") != 0) {
+    options.block_size = result["block-size"].as<size_t>();
+  }
+  if (result.count("buffer-size") != 0) {
+    options.buffer_size = result["buffer-size"].as<size_t>();
+  }
+  if (result.count("memory-limit") != 0) {
+    options.memory_limit = result["memory-limit"].as<size_t>();
+  }
+  options.checksum = frame_flags(result) != 0;
+  return options;
+}
+
+int show_results(std::vector<huffman::file_pair> const& files,
+                 std::vector<huffman::batch_result> const& results,
+                 bool compress, bool show_info) {
+  int exit_code = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!results[i].error.empty()) {
+      std::cerr << files[i].first.string() << ": " << results[i].error
+                << std::endl;
+      exit_code = 1;
+    } else if (show_info) {
+      show_files_info(files[i].first.string(), results[i].input_size,
+                      files[i].second.string(), results[i].output_size);
+      if (compress) {
+        show_compression_rate(results[i].output_size, results[i].input_size,
+                              true);
+      } else {
+        show_compression_rate(results[i].input_size, results[i].output_size,
+                              false);
+      }
+    }
+  }
+  return exit_code;
+}
+
+int run_batch(cxxopts::ParseResult const& result, bool compress,
+              bool show_info) {
+  huffman::batch_options options = get_batch_options(result);
+  std::vector<huffman::file_pair> files =
+      batch_files(result["input"].as<std::string>(),
+                  result["output"].as<std::string>(), compress);
+  std::vector<huffman::batch_result> results =
+      compress ? huffman::compress_files(files, options)
+               : huffman::decompress_files(files, options);
+  return show_results(files, results, compress, show_info);
+}
+
+// files are checked in parallel, as members of big files, only failed
+// files are shown without --info
+int run_test(cxxopts::ParseResult const& result, bool show_info) {
+  std::vector<std::filesystem::path> files;
+  if (result.count("batch") != 0) {
+    for_each_input(result["input"].as<std::string>(),
+                   [&files](std::filesystem::path const& file,
+                            std::filesystem::path const& /*relative_path*/) {
+                     files.push_back(file);
+                   });
+  } else {
+    files.emplace_back(result["input"].as<std::string>());
+  }
+  std::vector<huffman::batch_result> results =
+      huffman::verify_files(files, get_batch_options(result));
+  int exit_code = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!results[i].error.empty()) {
+      std::cerr << files[i].string() << ": " << results[i].error
+                << std::endl;
+      exit_code = 1;
+    } else if (show_info) {
+      std::cout << files[i].string() << ": OK, "
+                << show_size(results[i].input_size) << " decoded to "
+                << show_size(results[i].output_size) << std::endl;
+    }
+  }
+  return exit_code;
+}
+
+// server has its own working directory, so paths are absolute
+int run_client(cxxopts::ParseResult const& result, bool compress,
+               bool show_info) {
+  huffman::request request_;
+  request_.compress = compress;
+  request_.checksum = frame_flags(result) != 0;
+  std::string input = result["input"].as<std::string>();
+  std::string output = result["output"].as<std::string>();
+  if (result.count("batch") != 0) {
+    request_.files = batch_files(input, output, compress);
+  } else {
+    request_.files.emplace_back(input, output);
+  }
+  for (huffman::file_pair& files : request_.files) {
+    files.first = std::filesystem::absolute(files.first);
+    files.second = std::filesystem::absolute(files.second);
+  }
+  std::vector<huffman::batch_result> results;
+  try {
+    results = huffman::send_request(result["client"].as<std::string>(),
+                                    request_);
+  } catch (std::runtime_error const& e) {
+    error("Server", e.what());
+  }
+  return show_results(request_.files, results, compress, show_info);
+}
+
+int run_server_command(cxxopts::ParseResult const& result) {
+  try {
+    if (result.count("stop") != 0) {
+      huffman::stop_server(result["stop"].as<std::string>());
+      return 0;
+    }
+    huffman::server server_(result["serve"].as<std::string>(),
+                            get_batch_options(result));
+    server_.run();
+  } catch (std::runtime_error const& e) {
+    error("Server", e.what());
+  }
+  return 0;
+}
 } // namespace
 int main(int argc, char** argv) {
   cxxopts::Options options(
@@ -104,6 +747,53 @@ int main(int argc, char** argv) {
       ("i, info", "Show information about files")
       ("d,decompress", "Decompressing mode")
       ("c,compress", "Compressing mode")
+      ("e,estimate", "Show exact compressed size and entropy without "
+                     "writing output")
+      ("t,test", "Check that compressed file is decoded without errors and "
+                 "its checksums match, without writing output")
+      ("concat", "Append members of compressed input file to compressed "
+                 "output file")
+      ("append", "Append compressed file to the end of output file")
+      ("grep", "Find pattern in compressed file without decompressing it "
+               "to disk",
+               cxxopts::value<std::string>(), "pattern")
+      ("threshold", "Don't compress file if compressed size would be bigger "
+                    "than ratio * original size",
+               cxxopts::value<double>(), "ratio")
+      ("checksum", "Record CRC-32C checksum in compressed file, it is "
+                   "default")
+      ("no-checksum", "Don't record CRC-32C checksum in compressed file")
+      ("legacy", "Write compressed file without format signature, size and "
+                 "checksum, as older versions of the tool")
+      ("adaptive", "Split file to blocks with separate tables where it "
+                   "makes compressed file smaller")
+      ("filter", "Transform file before coding: rle replaces runs of equal "
+                 "bytes with their length, delta:N replaces bytes with "
+                 "difference with byte N bytes before, shuffle:N groups "
+                 "bytes of N-byte records by their position (N is 1 for "
+                 "delta and 4 for shuffle by default)",
+               cxxopts::value<std::string>(), "filter")
+      ("sample", "Estimate counts of chars from a sample of big file, so it "
+                 "is read once")
+      ("stats", "Print per-phase timings and counters as JSON")
+      ("b,batch", "Process all files from input directory or list")
+      ("serve", "Run compression server on UNIX domain socket",
+               cxxopts::value<std::string>(), "socket")
+      ("client", "Let compression server on socket process files",
+               cxxopts::value<std::string>(), "socket")
+      ("stop", "Stop compression server on socket",
+               cxxopts::value<std::string>(), "socket")
+      ("threads", "Number of threads in batch mode, in compression mode "
+                  "and in decompression of legacy files, where output is "
+                  "the same as with one thread",
+               cxxopts::value<size_t>(), "count")
+      ("block-size", "Size of blocks big files are split to in batch mode",
+               cxxopts::value<size_t>(), "bytes")
+      ("buffer-size", "Size of coding buffer, output is written every time "
+                      "it is full",
+               cxxopts::value<size_t>(), "bytes")
+      ("memory-limit", "Fail if coding buffers and tables need more memory",
+               cxxopts::value<size_t>(), "bytes")
       ("input", "Input file name",
                cxxopts::value<std::string>(), "filename")
       ("output", "Output file name",
@@ -113,8 +803,7 @@ int main(int argc, char** argv) {
   try {
     auto result = options.parse(argc, argv);
 
-    if (result.count("output") != 1 || result.count("input") != 1 ||
-        result.count("compress") + result.count("decompress") != 1 ||
+    if (!correct_files(result) || !correct_mode(result) ||
         !result.unmatched().empty()) {
       help(options, result);
       return 1;
@@ -123,51 +812,147 @@ int main(int argc, char** argv) {
       return 0;
     }
 
+    if (is_server_command(result)) {
+      return run_server_command(result);
+    }
+
     bool compress = result.count("compress") == 1;
+    bool estimate = result.count("estimate") == 1;
     bool show_info = result.count("info") >= 1;
+    bool show_stats_json = result.count("stats") >= 1;
+    auto start = std::chrono::steady_clock::now();
+
+    if (result.count("test") != 0) {
+      return run_test(result, show_info);
+    }
+    if (result.count("client") != 0) {
+      return run_client(result, compress, show_info);
+    }
+    if (result.count("batch") != 0) {
+      return run_batch(result, compress, show_info);
+    }
 
     std::string input_filename = result["input"].as<std::string>();
-    std::string output_filename = result["output"].as<std::string>();
 
-    if (compress) {
+    if (result.count("grep") != 0) {
+      return grep(result, input_filename, show_info);
+    }
+    if (result.count("concat") != 0) {
+      return concat(result, input_filename, show_info);
+    }
+    if (compress && result.count("sample") != 0) {
+      return compress_sampled(result, input_filename, show_info);
+    }
+    if ((compress || estimate) && result.count("filter") != 0) {
+      return compress_filtered(result, input_filename, estimate, show_info);
+    }
+    if ((compress || estimate) && result.count("adaptive") != 0) {
+      return compress_adaptive(result, input_filename, estimate, show_info);
+    }
+    if (compress || estimate) {
       std::ifstream count_stream(input_filename, std::ios::binary);
       ensure_open(count_stream);
 
       huffman::encoder encoder_;
+      encoder_.enable_stats(show_stats_json);
+      set_memory_options(encoder_, result);
       encoder_.add_chars(count_stream);
 
       count_stream.close();
 
+      encoder_.compile();
+      size_t input_size = encoder_.get_input_size();
+      size_t output_size = compressed_size(encoder_, result);
+      bool skip = exceeds_threshold(output_size, input_size, result);
+      if (estimate) {
+        show_estimate(input_filename, encoder_, output_size);
+        if (skip) {
+          std::cout << "File would be skipped with given threshold"
+                    << std::endl;
+        }
+        return 0;
+      }
+      if (skip) {
+        std::cout << "Skipped " << input_filename
+                  << ": compressed size would be " << show_size(output_size)
+                  << " of " << show_size(input_size) << std::endl;
+        return SKIPPED_EXIT_CODE;
+      }
+
+      std::string output_filename = result["output"].as<std::string>();
+
+      // parallel encoding writes whole output file
+      if (result.count("threads") != 0 && result["threads"].as<size_t>() > 1 &&
+          result.count("append") == 0) {
+        try {
+          encode_parallel(encoder_, input_filename, output_filename,
+                          output_size, result);
+        } catch (std::runtime_error const& e) {
+          error("Encoding", e.what());
+        }
+        if (show_info) {
+          show_files_info(input_filename, input_size, output_filename,
+                          output_size);
+          show_compression_rate(output_size, input_size, true);
+        }
+        if (show_stats_json) {
+          // header and trailer of member are written by encode_parallel
+          huffman::stats stats_ = encoder_.get_stats();
+          stats_.output_bytes = output_size;
+          show_stats(stats_, "compress", start);
+        }
+        return 0;
+      }
+
       std::ifstream input_stream(input_filename, std::ios::binary);
       ensure_open(input_stream);
 
-      std::ofstream output_stream(output_filename, std::ios::binary);
-      ensure_open(output_stream);
+      std::ofstream output_stream =
+          open_output(output_filename, result.count("append") != 0);
 
-      encoder_.encode(input_stream, output_stream);
+      try {
+        if (is_legacy(result)) {
+          encoder_.encode(input_stream, output_stream);
+        } else {
+          encoder_.encode_framed(input_stream, output_stream,
+                                 frame_flags(result));
+        }
+      } catch (std::runtime_error const& e) {
+        error("Encoding", e.what());
+      }
       if (show_info) {
-        size_t input_size = encoder_.get_input_size();
-        size_t output_size = encoder_.get_output_size();
         show_files_info(input_filename, input_size, output_filename,
                         output_size);
         show_compression_rate(output_size, input_size, true);
       }
+      if (show_stats_json) {
+        show_stats(encoder_.get_stats(), "compress", start);
+      }
     } else {
+      std::string output_filename = result["output"].as<std::string>();
+
       std::ifstream input_stream(input_filename, std::ios::binary);
       ensure_open(input_stream);
 
-      std::ofstream output_stream(output_filename, std::ios::binary);
-      ensure_open(output_stream);
-
       huffman::decoder decoder_;
+      decoder_.enable_stats(show_stats_json);
+      set_memory_options(decoder_, result);
       try {
-        auto [input_size, output_size] =
-            decoder_.decode(input_stream, output_stream);
+        size_t threads_count = result.count("threads") != 0
+                                   ? result["threads"].as<size_t>()
+                                   : 1;
+        huffman::stats stats_;
+        auto [input_size, output_size] = decode_file(
+            decoder_, input_stream, input_filename, output_filename,
+            threads_count, show_stats_json ? &stats_ : nullptr);
         if (show_info) {
           show_files_info(input_filename, input_size, output_filename,
                           output_size);
           show_compression_rate(input_size, output_size, false);
         }
+        if (show_stats_json) {
+          show_stats(stats_, "decompress", start);
+        }
       } catch (std::runtime_error const& e) {
         error("Decoding", e.what());
       }
@@ -176,5 +961,7 @@ int main(int argc, char** argv) {
     error("Parsing arguments", e.what());
   } catch (std::fstream::failure const& e) {
     error("I/O", e.what());
+  } catch (std::filesystem::filesystem_error const& e) {
+    error("I/O", e.what());
   }
 }
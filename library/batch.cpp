@@ -0,0 +1,320 @@
+#include "batch.h"
+#include "decoder.h"
+#include "encoder.h"
+#include "frame.h"
+#include "mapped_file.h"
+#include "memory_streambuf.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace huffman {
+namespace {
+struct file_job {
+  file_pair const& files;
+  batch_result& result;
+  std::mutex mutex;
+
+  template <typename F>
+  void run(F const& function) {
+    try {
+      function();
+    } catch (std::exception const& e) {
+      std::lock_guard lock(mutex);
+      if (result.error.empty()) {
+        result.error = e.what();
+      }
+    }
+  }
+};
+
+// state of file, that is split to blocks. Input is mapped once, so every
+// block is read by counting and encoding from the same pages
+struct blocks_state {
+  blocks_state(std::filesystem::path const& path, size_t count)
+      : input(path), encoders(count), remaining(count) {}
+
+  mapped_file input;
+  std::vector<std::unique_ptr<encoder>> encoders;
+  std::atomic<size_t> remaining;
+};
+
+std::string read_block(std::filesystem::path const& path, size_t offset,
+                       size_t size) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input.is_open()) {
+    throw std::runtime_error("cannot open input file");
+  }
+  input.seekg(static_cast<std::streamoff>(offset));
+  std::string result(size, '\0');
+  input.read(result.data(), static_cast<std::streamsize>(size));
+  if (static_cast<size_t>(input.gcount()) != size) {
+    throw std::runtime_error("cannot read input file");
+  }
+  return result;
+}
+
+void create_output(std::filesystem::path const& path, size_t size) {
+  {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+      throw std::runtime_error("cannot open output file");
+    }
+  }
+  std::filesystem::resize_file(path, size);
+}
+
+// several threads can write to different parts of output at the same time
+std::fstream open_output_at(std::filesystem::path const& path, size_t offset) {
+  std::fstream output(path, std::ios::in | std::ios::out | std::ios::binary);
+  if (!output.is_open()) {
+    throw std::runtime_error("cannot open output file");
+  }
+  output.seekp(static_cast<std::streamoff>(offset));
+  return output;
+}
+
+template <typename Coder>
+void configure(Coder& coder, batch_options const& options) {
+  coder.set_buffer_size(options.buffer_size);
+  coder.set_memory_limit(options.memory_limit);
+}
+
+uint8_t frame_flags(batch_options const& options, bool continued) {
+  return (options.checksum ? FRAME_FLAG_CHECKSUM : 0) |
+         (continued ? FRAME_FLAG_CONTINUED : 0);
+}
+
+size_t framed_size(encoder const& encoder_, batch_options const& options) {
+  return encoder_.get_output_size() + frame_overhead(frame_flags(options, false));
+}
+
+void encode_block(encoder& encoder_, uint8_t const* data, size_t size,
+                  std::ostream& output, uint8_t flags) {
+  memory_streambuf buffer(reinterpret_cast<char const*>(data), size);
+  std::istream input(&buffer);
+  encoder_.encode_framed(input, output, flags);
+  if (!output) {
+    throw std::runtime_error("cannot write output file");
+  }
+}
+
+void compress_blocks(thread_pool& pool, file_job& job,
+                     batch_options const& options, size_t block_size) {
+  size_t size = job.result.input_size;
+  size_t count = (size + block_size - 1) / block_size;
+  auto state = std::make_shared<blocks_state>(job.files.first, count);
+  if (state->input.size() != size) {
+    throw std::runtime_error("cannot read input file");
+  }
+  for (size_t i = 0; i < count; ++i) {
+    pool.submit([&pool, &job, &options, state, block_size, size, count, i] {
+      job.run([&] {
+        state->encoders[i] = std::make_unique<encoder>();
+        configure(*state->encoders[i], options);
+        state->encoders[i]->add_chars(
+            state->input.data() + i * block_size,
+            std::min(block_size, size - i * block_size));
+        state->encoders[i]->compile();
+        if (--state->remaining != 0) {
+          return;
+        }
+        // all blocks are counted, so their compressed sizes and offsets in
+        // output are known and blocks can be encoded independently
+        std::vector<size_t> offsets(count + 1, 0);
+        for (size_t j = 0; j < count; ++j) {
+          offsets[j + 1] =
+              offsets[j] + framed_size(*state->encoders[j], options);
+        }
+        create_output(job.files.second, offsets.back());
+        job.result.output_size = offsets.back();
+        for (size_t j = 0; j < count; ++j) {
+          pool.submit([&job, &options, state, block_size, size, count, j,
+                       offset = offsets[j]] {
+            job.run([&] {
+              std::fstream output = open_output_at(job.files.second, offset);
+              encode_block(*state->encoders[j],
+                           state->input.data() + j * block_size,
+                           std::min(block_size, size - j * block_size), output,
+                           frame_flags(options, j + 1 != count));
+            });
+          });
+        }
+      });
+    });
+  }
+}
+
+void compress_file(thread_pool& pool, file_job& job,
+                   batch_options const& options, size_t block_size) {
+  job.result.input_size = std::filesystem::file_size(job.files.first);
+  if (job.result.input_size > block_size) {
+    compress_blocks(pool, job, options, block_size);
+    return;
+  }
+  std::string data = read_block(job.files.first, 0, job.result.input_size);
+  encoder encoder_;
+  configure(encoder_, options);
+  encoder_.add_chars(reinterpret_cast<uint8_t const*>(data.data()),
+                     data.size());
+  encoder_.compile();
+  std::ofstream output(job.files.second, std::ios::binary);
+  if (!output.is_open()) {
+    throw std::runtime_error("cannot open output file");
+  }
+  encode_block(encoder_, reinterpret_cast<uint8_t const*>(data.data()),
+               data.size(), output, frame_flags(options, false));
+  job.result.output_size = framed_size(encoder_, options);
+}
+
+void decompress_file(thread_pool& pool, file_job& job,
+                     batch_options const& options) {
+  job.result.input_size = std::filesystem::file_size(job.files.first);
+  std::ifstream input(job.files.first, std::ios::binary);
+  if (!input.is_open()) {
+    throw std::runtime_error("cannot open input file");
+  }
+  std::vector<frame_member> members = read_members(input);
+  if (members.size() <= 1) {
+    input.clear();
+    input.seekg(0);
+    std::ofstream output(job.files.second, std::ios::binary);
+    if (!output.is_open()) {
+      throw std::runtime_error("cannot open output file");
+    }
+    decoder decoder_;
+    configure(decoder_, options);
+    job.result.output_size = decoder_.decode(input, output).second;
+    return;
+  }
+  // every member knows its original size, so output offsets are known.
+  // Sizes are bounded by payloads in file, see read_members
+  size_t output_offset = 0;
+  std::vector<size_t> offsets;
+  for (frame_member const& member : members) {
+    offsets.push_back(output_offset);
+    output_offset += member.header.original_size;
+  }
+  create_output(job.files.second, output_offset);
+  job.result.output_size = output_offset;
+  for (size_t i = 0; i < members.size(); ++i) {
+    pool.submit([&job, &options, member = members[i], offset = offsets[i]] {
+      job.run([&] {
+        std::string data =
+            read_block(job.files.first, member.offset, member.size());
+        memory_streambuf buffer(data.data(), data.size());
+        std::istream member_input(&buffer);
+        std::fstream output = open_output_at(job.files.second, offset);
+        decoder decoder_;
+        configure(decoder_, options);
+        decoder_.decode_member(member_input, output);
+        if (!output) {
+          throw std::runtime_error("cannot write output file");
+        }
+      });
+    });
+  }
+}
+
+void verify_file(thread_pool& pool, file_job& job,
+                 batch_options const& options) {
+  job.result.input_size = std::filesystem::file_size(job.files.first);
+  std::ifstream input(job.files.first, std::ios::binary);
+  if (!input.is_open()) {
+    throw std::runtime_error("cannot open input file");
+  }
+  std::vector<frame_member> members = read_members(input);
+  if (members.size() <= 1) {
+    input.clear();
+    input.seekg(0);
+    decoder decoder_;
+    configure(decoder_, options);
+    job.result.output_size = decoder_.verify(input).second;
+    return;
+  }
+  for (frame_member const& member : members) {
+    job.result.output_size += member.header.original_size;
+  }
+  for (frame_member const& member : members) {
+    pool.submit([&job, &options, member] {
+      job.run([&] {
+        std::string data =
+            read_block(job.files.first, member.offset, member.size());
+        memory_streambuf buffer(data.data(), data.size());
+        std::istream member_input(&buffer);
+        decoder decoder_;
+        configure(decoder_, options);
+        decoder_.verify_member(member_input);
+      });
+    });
+  }
+}
+
+template <typename F>
+std::vector<batch_result> process_files(std::vector<file_pair> const& files,
+                                        thread_pool& pool, F const& process) {
+  std::vector<batch_result> results(files.size());
+  std::vector<std::unique_ptr<file_job>> jobs;
+  for (size_t i = 0; i < files.size(); ++i) {
+    jobs.push_back(std::unique_ptr<file_job>(new file_job{files[i], results[i], {}}));
+  }
+  for (auto& job_ptr : jobs) {
+    pool.submit([&pool, &process, &job = *job_ptr] {
+      job.run([&] { process(pool, job); });
+    });
+  }
+  pool.wait();
+  return results;
+}
+} // namespace
+
+std::vector<batch_result> compress_files(std::vector<file_pair> const& files,
+                                         batch_options const& options) {
+  thread_pool pool(options.threads);
+  return compress_files(files, options, pool);
+}
+
+std::vector<batch_result> compress_files(std::vector<file_pair> const& files,
+                                         batch_options const& options,
+                                         thread_pool& pool) {
+  size_t block_size = std::max<size_t>(options.block_size, 1);
+  return process_files(files, pool,
+                       [&options, block_size](thread_pool& pool, file_job& job) {
+                         compress_file(pool, job, options, block_size);
+                       });
+}
+
+std::vector<batch_result> decompress_files(std::vector<file_pair> const& files,
+                                           batch_options const& options) {
+  thread_pool pool(options.threads);
+  return decompress_files(files, options, pool);
+}
+
+std::vector<batch_result> decompress_files(std::vector<file_pair> const& files,
+                                           batch_options const& options,
+                                           thread_pool& pool) {
+  return process_files(files, pool,
+                       [&options](thread_pool& pool, file_job& job) {
+                         decompress_file(pool, job, options);
+                       });
+}
+
+std::vector<batch_result>
+verify_files(std::vector<std::filesystem::path> const& files,
+             batch_options const& options) {
+  // files have no outputs
+  std::vector<file_pair> inputs;
+  for (std::filesystem::path const& file : files) {
+    inputs.emplace_back(file, std::filesystem::path());
+  }
+  thread_pool pool(options.threads);
+  return process_files(inputs, pool,
+                       [&options](thread_pool& pool, file_job& job) {
+                         verify_file(pool, job, options);
+                       });
+}
+} // namespace huffman
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "constants.h"
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace huffman {
+struct thread_pool;
+
+struct batch_options {
+  size_t threads{std::thread::hardware_concurrency()};
+  // files bigger than that are split to blocks, which are compressed to
+  // separate frame members in parallel
+  size_t block_size{BATCH_BLOCK_SIZE};
+  // coding buffer and memory limit of every encoder and decoder, see
+  // encoder::set_buffer_size and encoder::set_memory_limit
+  size_t buffer_size{DEFAULT_BUFFER_SIZE / BYTE_SIZE};
+  size_t memory_limit{0};
+  // members of compressed files have CRC-32C of original data
+  bool checksum{true};
+};
+
+struct batch_result {
+  size_t input_size{0};
+  size_t output_size{0};
+  // empty if file was processed successfully
+  std::string error;
+};
+
+// first - input file, second - output file
+using file_pair = std::pair<std::filesystem::path, std::filesystem::path>;
+
+// Compresses every file to framed stream, see frame.h.
+// Files and blocks of big files are processed on work-stealing thread pool
+std::vector<batch_result> compress_files(std::vector<file_pair> const& files,
+                                         batch_options const& options);
+
+// Decompresses every file. Members of framed streams are decoded in parallel
+std::vector<batch_result> decompress_files(std::vector<file_pair> const& files,
+                                           batch_options const& options);
+
+// The same on pool, that is not used by anything else until they return,
+// options.threads is ignored
+std::vector<batch_result> compress_files(std::vector<file_pair> const& files,
+                                         batch_options const& options,
+                                         thread_pool& pool);
+
+std::vector<batch_result> decompress_files(std::vector<file_pair> const& files,
+                                           batch_options const& options,
+                                           thread_pool& pool);
+
+// Checks that every compressed file is decoded without errors, nothing is
+// written. output_size of results is size of decoded data. Members of
+// framed streams are checked in parallel
+std::vector<batch_result>
+verify_files(std::vector<std::filesystem::path> const& files,
+             batch_options const& options);
+} // namespace huffman
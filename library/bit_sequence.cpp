@@ -1,4 +1,5 @@
 #include "bit_sequence.h"
+#include <algorithm>
 
 namespace huffman {
 bit_sequence& bit_sequence::append(bool bit) {
@@ -14,6 +15,11 @@ bit_sequence& bit_sequence::append(bit_sequence const& other) {
     append(other.data[i], ELEMENT_SIZE);
   }
 
+  // other has no element after full ones if its size is multiple of
+  // ELEMENT_SIZE
+  if (last_size == 0) {
+    return *this;
+  }
   return append(other.data[full_nums], last_size);
 }
 
@@ -85,6 +91,22 @@ void bit_sequence::pop_back() {
     data.pop_back();
   }
 }
+void bit_sequence::erase_front(size_t count) {
+  size_t new_size = size_ - count;
+  size_t new_elements = (new_size + ELEMENT_SIZE - 1) >> LOG_ELEMENT_SIZE;
+  for (size_t i = 0; i < new_elements; ++i) {
+    size_t start = i * ELEMENT_SIZE;
+    data[i] = get_number(std::min<size_t>(ELEMENT_SIZE, new_size - start), count + start);
+  }
+  data.resize(new_elements);
+  size_ = new_size;
+}
+void bit_sequence::reserve(size_t size) {
+  data.reserve((size + ELEMENT_SIZE - 1) >> LOG_ELEMENT_SIZE);
+}
+size_t bit_sequence::memory_usage() const {
+  return data.capacity() * sizeof(uint64_t);
+}
 size_t bit_sequence::size() const {
   return size_;
 }
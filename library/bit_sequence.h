@@ -24,6 +24,14 @@ struct bit_sequence {
 
   void pop_back();
 
+  // removes first count bits, allocated memory is kept
+  void erase_front(size_t count);
+
+  void reserve(size_t size);
+
+  // bytes allocated for bits
+  size_t memory_usage() const;
+
   size_t size() const;
 
   bool operator[](size_t i) const;
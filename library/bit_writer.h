@@ -0,0 +1,77 @@
+#pragma once
+
+#include "bit_sequence.h"
+#include "constants.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace huffman {
+// Packs bits to 64-bit words from given bit offset. Every filled word is
+// passed to sink with its index, as sink(index, word), the last partially
+// filled one is passed by finish
+template <typename Sink>
+struct bit_writer {
+  bit_writer(Sink sink, size_t offset)
+      : sink(sink), index(offset / WORD_SIZE), filled(offset % WORD_SIZE) {}
+
+  void write(uint64_t value, size_t size) {
+    current |= value << filled;
+    if (filled + size < WORD_SIZE) {
+      filled += size;
+      return;
+    }
+    sink(index++, current);
+    // higher bits of value, that didn't fit to current word
+    current = filled == 0 ? 0 : value >> (WORD_SIZE - filled);
+    filled = filled + size - WORD_SIZE;
+  }
+
+  void write(bit_sequence const& bits) {
+    for (size_t i = 0; i < bits.size(); i += WORD_SIZE) {
+      size_t size = std::min(WORD_SIZE, bits.size() - i);
+      write(bits.get_number(size, i), size);
+    }
+  }
+
+  // value is code as number if code is not longer than a word, see
+  // code_values
+  void write_code(bit_sequence const& code, uint64_t value) {
+    if (code.size() <= WORD_SIZE) {
+      write(value, code.size());
+    } else {
+      write(code);
+    }
+  }
+
+  void finish() {
+    if (filled != 0) {
+      sink(index, current);
+    }
+  }
+
+  // number of bits from the start of output
+  size_t position() const {
+    return index * WORD_SIZE + filled;
+  }
+
+private:
+  Sink sink;
+  size_t index;
+  size_t filled;
+  uint64_t current{0};
+};
+
+// Sink of bit_writer that appends words to string as little-endian bytes,
+// so string must already have bytes of words before offset
+struct string_sink {
+  std::string& output;
+
+  void operator()(size_t /*index*/, uint64_t word) const {
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      output.push_back(static_cast<char>(word >> (i * BYTE_SIZE)));
+    }
+  }
+};
+} // namespace huffman
@@ -0,0 +1,202 @@
+#include "codec.h"
+#include "bit_writer.h"
+#include "decoder.h"
+#include "frame.h"
+#include "table_cache.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace huffman {
+namespace {
+// bits after tree traversal, where padding of stream is written
+size_t traversal_end(uint8_t first_byte) {
+  return BYTE_SIZE + (first_byte * 2 + 1) * LOG_MAX_NODE_NUMBER;
+}
+} // namespace
+
+codec::codec(std::array<size_t, CHARS_COUNT> const& counts) {
+  if (std::all_of(counts.begin(), counts.end(),
+                  [](size_t count) { return count == 0; })) {
+    throw std::runtime_error("Codec needs a char with nonzero count");
+  }
+  tree_ = std::make_unique<tree const>(counts);
+  bit_sequence header = tree_->header();
+  serialized.assign(
+      decoder::get_header_size(header.get_number(BYTE_SIZE, 0)), '\0');
+  for (size_t i = 0; i < header.size(); i += BYTE_SIZE) {
+    serialized[i / BYTE_SIZE] = static_cast<char>(
+        header.get_number(std::min(BYTE_SIZE, header.size() - i), i));
+  }
+}
+
+codec::codec(uint8_t const* header, size_t size) {
+  if (size == 0 || header[0] == 0 ||
+      decoder::get_header_size(header[0]) > size) {
+    throw std::runtime_error("Incorrect input");
+  }
+  decoder::traversal_array traversal; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  size_t traversal_size = decoder::read_traversal(header, traversal);
+  tree_ = std::make_unique<tree const>(traversal.data(), traversal_size);
+  // padding bits are zero, so streams with the same tree give the same codec
+  table_cache::key_buffer key_buffer;
+  std::string_view key = table_cache::get_key(header, key_buffer);
+  serialized.assign(decoder::get_header_size(header[0]), '\0');
+  std::copy(key.begin(), key.end(), serialized.begin());
+}
+
+std::string const& codec::serialize() const {
+  return serialized;
+}
+
+bit_sequence const& codec::get_code(uint8_t ch) const {
+  return get_table().codes[ch];
+}
+
+std::array<bit_sequence, CHARS_COUNT> const& codec::get_codes() const {
+  return get_table().codes;
+}
+
+std::array<uint64_t, CHARS_COUNT> const& codec::get_code_values() const {
+  return get_table().values;
+}
+
+codec::code_table const& codec::get_table() const {
+  std::call_once(codes_built, [this] {
+    table = std::make_unique<code_table>();
+    tree_->get_codes(table->codes);
+    for (size_t ch = 0; ch < CHARS_COUNT; ++ch) {
+      bit_sequence const& code = table->codes[ch];
+      if (code.size() <= WORD_SIZE) {
+        table->values[ch] = code.get_number(code.size(), 0);
+      }
+    }
+    has_codes.store(true, std::memory_order_release);
+  });
+  return *table;
+}
+
+tree const& codec::get_tree() const {
+  return *tree_;
+}
+
+size_t codec::decode(uint8_t const* data, size_t size, bit_sequence& buffer,
+                     uint8_t* output, size_t capacity) const {
+  size_t header_size = decoder::get_header_size(data[0]);
+  size_t padding_start = traversal_end(data[0]);
+  size_t end_padding = decoder::read_bits(data, padding_start, 3);
+
+  buffer.erase_front(buffer.size());
+  size_t rest_start = padding_start + 3;
+  size_t rest_size = header_size * BYTE_SIZE - rest_start;
+  buffer.append(decoder::read_bits(data, rest_start, rest_size), rest_size);
+  size_t i = header_size;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    buffer.append(read_number(data + i, sizeof(uint64_t)),
+                  sizeof(uint64_t) * BYTE_SIZE);
+  }
+  for (; i < size; ++i) {
+    buffer.append(data[i], BYTE_SIZE);
+  }
+  if (buffer.size() < end_padding) {
+    throw std::runtime_error("Incorrect input");
+  }
+  // chars are decoded straight to caller's output
+  auto [idx, write_size] =
+      tree_->dump(buffer, buffer.size() - end_padding, output, capacity);
+  if (buffer.size() - idx != end_padding) {
+    throw std::runtime_error(write_size == capacity ? "Output is too small"
+                                                    : "Incorrect input");
+  }
+  return write_size;
+}
+
+size_t codec::memory_usage() const {
+  size_t result = tree_->memory_usage() + serialized.size();
+  if (has_codes.load(std::memory_order_acquire)) {
+    result += sizeof(code_table);
+    for (bit_sequence const& code : table->codes) {
+      result += code.memory_usage();
+    }
+  }
+  return result;
+}
+
+size_t codec::memory_usage(size_t leafs_count) {
+  return tree::memory_usage(leafs_count) +
+         decoder::get_header_size(static_cast<uint8_t>(leafs_count - 1));
+}
+
+encode_session::encode_session(std::shared_ptr<codec const> compiled)
+    : codec_(std::move(compiled)) {}
+
+void encode_session::encode(uint8_t const* data, size_t size,
+                            std::string& output) {
+  if (size == 0) {
+    // empty stream consists of one zero byte
+    output.assign(1, '\0');
+    return;
+  }
+  std::string const& header = codec_->serialize();
+  size_t padding_start = traversal_end(static_cast<uint8_t>(header[0]));
+  size_t header_size = padding_start + 3;
+  // codes are written after header, which padding is known only at the end
+  output.assign(header_size / WORD_SIZE * sizeof(uint64_t), '\0');
+  bit_writer writer(string_sink{output}, header_size);
+  std::array<bit_sequence, CHARS_COUNT> const& codes = codec_->get_codes();
+  std::array<uint64_t, CHARS_COUNT> const& values =
+      codec_->get_code_values();
+  for (size_t i = 0; i < size; ++i) {
+    bit_sequence const& code = codes[data[i]];
+    if (code.size() == 0) {
+      std::string message("Unexpected char to encode: ");
+      message.append(1, static_cast<char>(data[i]));
+      throw std::runtime_error(message);
+    }
+    writer.write_code(code, values[data[i]]);
+  }
+  size_t total_size = writer.position();
+  writer.finish();
+  output.resize((total_size + BYTE_SIZE - 1) / BYTE_SIZE);
+
+  // header bits after traversal are zero, codes start after them
+  for (size_t i = 0; i < header.size(); ++i) {
+    output[i] = static_cast<char>(output[i] | header[i]);
+  }
+  size_t padding = (BYTE_SIZE - total_size % BYTE_SIZE) % BYTE_SIZE;
+  for (size_t i = 0; i < 3; ++i) {
+    size_t bit = padding_start + i;
+    if (((padding >> i) & 1u) != 0) {
+      output[bit / BYTE_SIZE] = static_cast<char>(
+          output[bit / BYTE_SIZE] | (1u << (bit % BYTE_SIZE)));
+    }
+  }
+}
+
+decode_session::decode_session(std::shared_ptr<codec const> compiled)
+    : codec_(std::move(compiled)) {}
+
+size_t decode_session::decode(uint8_t const* data, size_t size,
+                              uint8_t* output, size_t capacity) {
+  if (size == 0) {
+    throw std::runtime_error("Incorrect input");
+  }
+  if (data[0] == 0) {
+    // empty stream consists of one zero byte
+    if (size != 1) {
+      throw std::runtime_error("Incorrect input");
+    }
+    return 0;
+  }
+  if (decoder::get_header_size(data[0]) > size) {
+    throw std::runtime_error("Incorrect input");
+  }
+  table_cache::key_buffer key_buffer;
+  std::string_view key = table_cache::get_key(data, key_buffer);
+  if (std::string_view(codec_->serialize()).substr(0, key.size()) != key) {
+    throw std::runtime_error("Stream is coded by other codec");
+  }
+  return codec_->decode(data, size, buffer, output, capacity);
+}
+} // namespace huffman
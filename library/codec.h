@@ -0,0 +1,109 @@
+#pragma once
+
+#include "bit_sequence.h"
+#include "constants.h"
+#include "tree.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace huffman {
+// Compiled codes of chars and decoding tables of one tree. Codes and tables
+// are built once at their first use, so codec is immutable after that and
+// any number of threads share it by const reference or shared_ptr without
+// locks. Mutable state is kept by sessions, encoder and decoders
+struct codec {
+  codec(codec const& other) = delete;
+
+  codec& operator=(codec const& other) = delete;
+
+  ~codec() = default;
+
+  // Codes of chars with nonzero counts, decoding tables are built at the
+  // first decode. Throws std::runtime_error if all counts are zero
+  explicit codec(std::array<size_t, CHARS_COUNT> const& counts);
+
+  // header of non-empty legacy stream or serialized codec, see serialize.
+  // Decoding tables are built at once, codes are built at their first use.
+  // Throws std::runtime_error if header is incorrect or longer than size
+  codec(uint8_t const* header, size_t size);
+
+  // header of legacy stream without padding, so it is read back by codec
+  // constructor
+  std::string const& serialize() const;
+
+  // empty for chars without code
+  bit_sequence const& get_code(uint8_t ch) const;
+
+  std::array<bit_sequence, CHARS_COUNT> const& get_codes() const;
+
+  // codes not longer than WORD_SIZE bits as numbers, see
+  // bit_writer::write_code
+  std::array<uint64_t, CHARS_COUNT> const& get_code_values() const;
+
+  tree const& get_tree() const;
+
+  // Decodes non-empty legacy stream, which header is already checked to be
+  // the header of codec, to output of capacity bytes through buffer.
+  // Returns size of decoded data. Throws std::runtime_error if stream is
+  // incorrect or output is too small
+  size_t decode(uint8_t const* data, size_t size, bit_sequence& buffer,
+                uint8_t* output, size_t capacity) const;
+
+  // bytes of header, codes and decoding tables, that are built
+  size_t memory_usage() const;
+
+  // memory_usage of codec with leafs_count leafs read from header, so
+  // memory is checked before codec is built
+  static size_t memory_usage(size_t leafs_count);
+
+private:
+  // decoders don't need codes, so they are allocated only when used
+  struct code_table {
+    std::array<bit_sequence, CHARS_COUNT> codes;
+    std::array<uint64_t, CHARS_COUNT> values{};
+  };
+
+  code_table const& get_table() const;
+
+  std::string serialized;
+  std::unique_ptr<tree const> tree_;
+  mutable std::once_flag codes_built;
+  // set after codes are built, so memory_usage doesn't race with building
+  mutable std::atomic<bool> has_codes{false};
+  mutable std::unique_ptr<code_table> table;
+};
+
+// Encodes buffers to legacy streams with shared codec, one session is used
+// by one thread at a time
+struct encode_session {
+  explicit encode_session(std::shared_ptr<codec const> compiled);
+
+  // Replaces output with legacy stream of data, see decoder. Throws
+  // std::runtime_error if data has a char without code
+  void encode(uint8_t const* data, size_t size, std::string& output);
+
+private:
+  std::shared_ptr<codec const> codec_;
+};
+
+// Decodes legacy streams coded by shared codec, one session is used by one
+// thread at a time. Tables are not looked up by header, it is only checked
+struct decode_session {
+  explicit decode_session(std::shared_ptr<codec const> compiled);
+
+  // Decodes stream to output of capacity bytes, returns size of decoded
+  // data. Throws std::runtime_error if stream is incorrect, is coded by
+  // other codec or output is too small
+  size_t decode(uint8_t const* data, size_t size, uint8_t* output,
+                size_t capacity);
+
+private:
+  std::shared_ptr<codec const> codec_;
+  bit_sequence buffer;
+};
+} // namespace huffman
@@ -1,12 +1,68 @@
 #pragma once
+#include <array>
 #include <cstddef>
+#include <cstdint>
 
 namespace huffman {
 static constexpr size_t CHARS_COUNT = 256;
 static constexpr size_t LOG_CHARS_COUNT = 8;
 static constexpr size_t BYTE_SIZE = 8;
 static constexpr size_t LOG_MAX_NODE_NUMBER = 9;
-static constexpr size_t MAX_BUFFER_SIZE = 4096 * BYTE_SIZE;
+// default size of coding buffer in bits, see encoder::set_buffer_size
+static constexpr size_t DEFAULT_BUFFER_SIZE = 4096 * BYTE_SIZE;
 static constexpr size_t TREE_SHORTCUT_SIZE = 4;
-static constexpr size_t TREE_SHORTCUT_CHARS_COUNT = 64;
+// number of different TREE_SHORTCUT_SIZE-bit paths
+static constexpr size_t TREE_SHORTCUT_CHARS_COUNT = 1u << TREE_SHORTCUT_SIZE;
+static constexpr size_t IO_CHUNK_SIZE = 4096;
+// bits are packed to words of that size, see bit_writer
+static constexpr size_t WORD_SIZE = 64;
+// legacy stream can start with zero byte only if it is its only byte
+static constexpr std::array<uint8_t, 4> FRAME_MAGIC = {0, 'H', 'U', 'F'};
+static constexpr uint8_t FRAME_VERSION = 2;
+static constexpr size_t FRAME_HEADER_SIZE = FRAME_MAGIC.size() + 2 + 2 * 8;
+// version 1 header has no flags byte, its members always have checksum
+static constexpr size_t FRAME_V1_HEADER_SIZE = FRAME_HEADER_SIZE - 1;
+static constexpr size_t FRAME_TRAILER_SIZE = 4;
+// member ends with CRC-32C of original data
+static constexpr uint8_t FRAME_FLAG_CHECKSUM = 1u << 0u;
+// more members of the same stream follow that member
+static constexpr uint8_t FRAME_FLAG_CONTINUED = 1u << 1u;
+// payload is coded after filter, its type and width follow header
+static constexpr uint8_t FRAME_FLAG_FILTER = 1u << 2u;
+static constexpr size_t FRAME_FILTER_SIZE = 2;
+// members with other flags are rejected, so new features can't be misread
+static constexpr uint8_t FRAME_KNOWN_FLAGS =
+    FRAME_FLAG_CHECKSUM | FRAME_FLAG_CONTINUED | FRAME_FLAG_FILTER;
+// files bigger than that are compressed by several threads in batch mode
+static constexpr size_t BATCH_BLOCK_SIZE = 16 * 1024 * 1024;
+// adaptive encoding chooses block boundaries between granules of that size
+static constexpr size_t PARTITION_GRANULE_SIZE = 64 * 1024;
+// counts of big inputs are estimated from that number of bytes, read by
+// chunks of SAMPLE_CHUNK_SIZE, see sample_counts
+static constexpr size_t SAMPLE_SIZE = 4 * 1024 * 1024;
+static constexpr size_t SAMPLE_CHUNK_SIZE = 64 * 1024;
+// sampled encoding to unseekable output writes members of that size
+static constexpr size_t SAMPLED_MEMBER_SIZE = 16 * 1024 * 1024;
+// input of parallel encoding is split to chunks of that size
+static constexpr size_t PARALLEL_CHUNK_SIZE = 1024 * 1024;
+// legacy stream is decoded speculatively by chunks of that size, see
+// decode_speculative
+static constexpr size_t SPECULATIVE_CHUNK_SIZE = 1024 * 1024;
+// speculative decoding of chunk must meet exact decoding of previous one
+// within that number of bits
+static constexpr size_t SYNC_WINDOW_SIZE = 4096;
+// types of requests to compression server, see server
+static constexpr uint8_t REQUEST_COMPRESS = 'c';
+static constexpr uint8_t REQUEST_DECOMPRESS = 'd';
+static constexpr uint8_t REQUEST_STOP = 'q';
+// bigger requests and responses of compression server are rejected
+static constexpr size_t MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+// server drops connection that is idle for that time, so it doesn't block
+// other clients
+static constexpr size_t CONNECTION_TIMEOUT_MS = 1000;
+// client gives up on server, that doesn't respond for that time, so it
+// should cover processing of the biggest request
+static constexpr size_t RESPONSE_TIMEOUT_MS = 10 * 60 * 1000;
+// memory of decoding trees shared by all decoders, see table_cache
+static constexpr size_t TABLE_CACHE_SIZE = 16 * 1024 * 1024;
 }
@@ -0,0 +1,97 @@
+#include "crc32c.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HUFFMAN_CRC32C_HW
+#include <nmmintrin.h>
+#endif
+
+namespace huffman {
+namespace {
+constexpr uint32_t POLYNOMIAL = 0x82F63B78; // reflected 0x1EDC6F41
+constexpr size_t SLICES = 8;
+
+using crc_tables = std::array<std::array<uint32_t, 256>, SLICES>;
+
+constexpr crc_tables make_tables() {
+  crc_tables result{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (size_t bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1u) != 0 ? POLYNOMIAL : 0);
+    }
+    result[0][i] = crc;
+  }
+  // tables[k][i] is crc of byte i followed by k zero bytes
+  for (size_t k = 1; k < SLICES; ++k) {
+    for (size_t i = 0; i < 256; ++i) {
+      uint32_t prev = result[k - 1][i];
+      result[k][i] = (prev >> 8) ^ result[0][prev & 0xFFu];
+    }
+  }
+  return result;
+}
+
+constexpr crc_tables TABLES = make_tables();
+
+uint32_t update_sw(uint32_t crc, uint8_t const* data, size_t size) {
+  while (size >= SLICES) {
+    uint32_t low;  // NOLINT(cppcoreguidelines-init-variables)
+    uint32_t high; // NOLINT(cppcoreguidelines-init-variables)
+    std::memcpy(&low, data, 4);
+    std::memcpy(&high, data + 4, 4);
+    // crc is defined for little-endian byte order of words
+    low ^= crc;
+    crc = TABLES[7][low & 0xFFu] ^ TABLES[6][(low >> 8) & 0xFFu] ^
+          TABLES[5][(low >> 16) & 0xFFu] ^ TABLES[4][low >> 24] ^
+          TABLES[3][high & 0xFFu] ^ TABLES[2][(high >> 8) & 0xFFu] ^
+          TABLES[1][(high >> 16) & 0xFFu] ^ TABLES[0][high >> 24];
+    data += SLICES;
+    size -= SLICES;
+  }
+  while (size-- > 0) {
+    crc = (crc >> 8) ^ TABLES[0][(crc ^ *data++) & 0xFFu];
+  }
+  return crc;
+}
+
+#ifdef HUFFMAN_CRC32C_HW
+__attribute__((target("sse4.2"))) uint32_t
+update_hw(uint32_t crc, uint8_t const* data, size_t size) {
+  uint64_t crc64 = crc;
+  while (size >= sizeof(uint64_t)) {
+    uint64_t word; // NOLINT(cppcoreguidelines-init-variables)
+    std::memcpy(&word, data, sizeof(uint64_t));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += sizeof(uint64_t);
+    size -= sizeof(uint64_t);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (size-- > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+
+bool has_hw() {
+  static bool const result = __builtin_cpu_supports("sse4.2");
+  return result;
+}
+#endif
+} // namespace
+
+void crc32c::update(uint8_t const* data, size_t size) {
+#ifdef HUFFMAN_CRC32C_HW
+  if (has_hw()) {
+    state = update_hw(state, data, size);
+    return;
+  }
+#endif
+  state = update_sw(state, data, size);
+}
+
+uint32_t crc32c::value() const {
+  return ~state;
+}
+} // namespace huffman
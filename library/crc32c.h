@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace huffman {
+// CRC-32C (Castagnoli) checksum, computed incrementally.
+// Uses SSE4.2 crc32 instruction if CPU supports it, slicing-by-8 otherwise
+struct crc32c {
+  crc32c() = default;
+
+  crc32c(crc32c const& other) = default;
+
+  crc32c& operator=(crc32c const& other) = default;
+
+  ~crc32c() = default;
+
+  void update(uint8_t const* data, size_t size);
+
+  uint32_t value() const;
+
+private:
+  static constexpr uint32_t INITIAL = 0xFFFFFFFF;
+
+  uint32_t state{INITIAL};
+};
+} // namespace huffman
@@ -1,9 +1,39 @@
 #include "decoder.h"
+#include "codec.h"
+#include "frame.h"
+#include "table_cache.h"
+#include <algorithm>
 #include <cassert>
+#include <limits>
 #include <memory>
 #include <stdexcept>
+#include <streambuf>
+#include <tuple>
 
 namespace huffman {
+namespace {
+// appends written data to string, which isn't copied as by
+// std::ostringstream::str
+struct string_streambuf : std::streambuf {
+  explicit string_streambuf(std::string& result) : result(result) {}
+
+protected:
+  std::streamsize xsputn(char const* data, std::streamsize size) override {
+    result.append(data, static_cast<size_t>(size));
+    return size;
+  }
+
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      result.push_back(traits_type::to_char_type(ch));
+    }
+    return ch;
+  }
+
+private:
+  std::string& result;
+};
+} // namespace
 
 size_t decoder::get_header_size(uint8_t first_byte) {
   // if first byte is 0 than it is only byte in encoded file,
@@ -20,80 +50,421 @@ size_t decoder::get_header_size(uint8_t first_byte) {
              BYTE_SIZE +
          1;
 }
-void decoder::read_header(std::vector<uint8_t> const& header) {
-  // decoder must be empty
-  assert(tree_ == nullptr);
-  assert(buffer.size() == 0);
-  bit_sequence seq;
-  for (uint8_t byte : header) {
-    seq.append(byte, BYTE_SIZE);
-  }
-  size_t traversal_size = header[0] * 2 + 1;
-  std::vector<uint16_t> traversal;
-  traversal.reserve(traversal_size);
-  for (size_t idx = BYTE_SIZE;
-       idx < BYTE_SIZE + traversal_size * LOG_MAX_NODE_NUMBER;
-       idx += LOG_MAX_NODE_NUMBER) {
-    traversal.push_back(seq.get_number(LOG_MAX_NODE_NUMBER, idx));
+uint64_t decoder::read_bits(uint8_t const* data, size_t start, size_t count) {
+  uint64_t result = 0;
+  size_t first = start / BYTE_SIZE;
+  size_t last = (start + count + BYTE_SIZE - 1) / BYTE_SIZE;
+  for (size_t i = first; i < last; ++i) {
+    result |= static_cast<uint64_t>(data[i]) << ((i - first) * BYTE_SIZE);
   }
+  return (result >> (start % BYTE_SIZE)) & ((uint64_t(1) << count) - 1);
+}
 
+size_t decoder::read_traversal(uint8_t const* header,
+                               traversal_array& traversal) {
+  size_t traversal_size = header[0] * 2 + 1;
   std::array<bool, CHARS_COUNT> chars{false};
-  for (uint16_t node : traversal) {
+  for (size_t i = 0; i < traversal_size; ++i) {
+    uint16_t node = read_bits(header, BYTE_SIZE + i * LOG_MAX_NODE_NUMBER,
+                              LOG_MAX_NODE_NUMBER);
     if (node < CHARS_COUNT) {
-      if (chars[node] && traversal.size() != 3) {
+      if (chars[node] && traversal_size != 3) {
         throw std::runtime_error("Incorrect input");
       }
       chars[node] = true;
     } else if (node != CHARS_COUNT) {
       throw std::runtime_error("Incorrect input");
     }
+    traversal[i] = node;
   }
+  return traversal_size;
+}
 
-  tree_ = std::make_unique<tree>(traversal);
-  end_padding =
-      seq.get_number(3, BYTE_SIZE + LOG_MAX_NODE_NUMBER * traversal_size);
-  for (size_t i = 3 + BYTE_SIZE + LOG_MAX_NODE_NUMBER * traversal_size;
-       i < seq.size(); ++i) {
-    buffer.append(seq[i]);
+void decoder::read_header(uint8_t const* header, size_t size) {
+  // decoder must be empty
+  assert(codec_ == nullptr);
+  assert(buffer.size() == 0);
+  size_t traversal_size = header[0] * 2 + 1;
+  size_t traversal_end = BYTE_SIZE + traversal_size * LOG_MAX_NODE_NUMBER;
+  assert(traversal_end + 3 <= size * BYTE_SIZE);
+
+  {
+    // traversal is parsed only if codec is not cached
+    stats_timer timer(collect_stats, stats_.tree_build_time);
+    codec_ = table_cache::global().get(header);
   }
+  end_padding = read_bits(header, traversal_end, 3);
+  size_t rest_size = size * BYTE_SIZE - traversal_end - 3;
+  buffer.append(read_bits(header, traversal_end + 3, rest_size), rest_size);
 }
 std::pair<size_t, size_t> decoder::decode(std::istream& input, std::ostream& output) {
   uint8_t first_byte = input.get();
-  size_t rest_header_size = get_header_size(first_byte) - 1;
-  std::vector<uint8_t> header(rest_header_size + 1);
-  header[0] = first_byte;
-  for (size_t i = 0; i < rest_header_size; ++i) {
-    header[i + 1] = input.get();
+  if (first_byte != FRAME_MAGIC[0] ||
+      input.peek() == std::char_traits<char>::eof()) {
+    return decode_payload(first_byte, input, output,
+                          std::numeric_limits<size_t>::max());
   }
-  read_header(header);
-  size_t input_size = rest_header_size + 1;
+  size_t input_size = 0;
   size_t output_size = 0;
   while (true) {
-    uint8_t ch = input.get();
+    if (first_byte != FRAME_MAGIC[0]) {
+      throw std::runtime_error("Incorrect input");
+    }
+    frame_header header_;
+    {
+      stats_timer timer(collect_stats, stats_.header_time);
+      header_ = frame_header::read(input);
+    }
+    auto [member_input_size, member_output_size] =
+        decode_framed(header_, input, output);
+    input_size += member_input_size;
+    output_size += member_output_size;
+    first_byte = input.get();
     if (input.fail()) {
+      // continued member means that the rest of stream is lost
+      if (header_.has_flag(FRAME_FLAG_CONTINUED)) {
+        throw std::runtime_error("Incorrect input");
+      }
       break;
     }
-    ++input_size;
-    buffer.append(ch, BYTE_SIZE);
-    if (buffer.size() > MAX_BUFFER_SIZE) {
+  }
+  return {input_size, output_size};
+}
+
+size_t decoder::decode(std::istream& input, uint8_t* output,
+                       size_t capacity) {
+  span = {output, capacity, 0};
+  // nothing is written to stream, decoded chars go to span
+  std::ostream unused(nullptr);
+  try {
+    decode(input, unused);
+  } catch (...) {
+    span = {};
+    throw;
+  }
+  size_t result = span.size;
+  span = {};
+  return result;
+}
+
+std::pair<size_t, size_t> decoder::decode_member(std::istream& input,
+                                                 std::ostream& output) {
+  if (input.get() != FRAME_MAGIC[0]) {
+    throw std::runtime_error("Incorrect input");
+  }
+  frame_header header_;
+  {
+    stats_timer timer(collect_stats, stats_.header_time);
+    header_ = frame_header::read(input);
+  }
+  return decode_framed(header_, input, output);
+}
+
+std::pair<size_t, size_t> decoder::verify(std::istream& input) {
+  return verify_stream(input, false);
+}
+
+std::pair<size_t, size_t> decoder::verify_member(std::istream& input) {
+  return verify_stream(input, true);
+}
+
+std::pair<size_t, size_t> decoder::verify_stream(std::istream& input,
+                                                 bool member) {
+  // every decoded char takes at least one bit, so chars of one flush fit
+  std::vector<uint8_t> scratch(buffer_size + CHARS_COUNT + 2 * BYTE_SIZE);
+  span = {scratch.data(), scratch.size(), 0, true};
+  std::ostream unused(nullptr);
+  std::pair<size_t, size_t> result;
+  try {
+    result = member ? decode_member(input, unused) : decode(input, unused);
+  } catch (...) {
+    span = {};
+    throw;
+  }
+  span = {};
+  return result;
+}
+
+std::pair<size_t, size_t> decoder::decode_framed(frame_header const& header_,
+                                                 std::istream& input,
+                                                 std::ostream& output) {
+  has_checksum = header_.has_flag(FRAME_FLAG_CHECKSUM);
+  checksum = crc32c();
+  uint8_t first_byte = input.get();
+  auto [input_size, output_size] =
+      header_.has_flag(FRAME_FLAG_FILTER)
+          ? decode_filtered(header_, first_byte, input, output)
+          : decode_payload(first_byte, input, output, header_.payload_size);
+  if (input_size != header_.payload_size ||
+      output_size != header_.original_size) {
+    throw std::runtime_error("Incorrect input");
+  }
+  if (has_checksum &&
+      read_number(input, FRAME_TRAILER_SIZE) != checksum.value()) {
+    throw std::runtime_error("Checksum mismatch");
+  }
+  size_t overhead = header_.header_size() + header_.trailer_size();
+  stats_.input_bytes += overhead;
+  return {input_size + overhead, output_size};
+}
+
+std::pair<size_t, size_t> decoder::decode_filtered(frame_header const& header_,
+                                                   uint8_t first_byte,
+                                                   std::istream& input,
+                                                   std::ostream& output) {
+  bool to_span = span.data != nullptr && !span.discard;
+  // untrusted original size is checked against payload before anything is
+  // allocated
+  if (header_.original_size > header_.max_original_size()) {
+    throw std::runtime_error("Incorrect input");
+  }
+  // filtered data is kept whole, restored one goes to caller's memory or
+  // by chunks to output
+  filtered.clear();
+  kept_memory = 0;
+  if (memory_limit != 0) {
+    if (header_.original_size > memory_limit) {
+      throw std::runtime_error("Memory limit exceeded");
+    }
+    size_t filtered_size =
+        header_.filter_.max_filtered_size(header_.original_size);
+    kept_memory = filtered_size;
+    if (kept_memory > memory_limit) {
+      throw std::runtime_error("Memory limit exceeded");
+    }
+    filtered.reserve(filtered_size);
+  }
+  // checksum is computed over restored data, and decoded data goes to
+  // filtered even if output is memory
+  bool restored_checksum = has_checksum;
+  output_span caller_span = span;
+  has_checksum = false;
+  span = {};
+  string_streambuf filtered_buffer(filtered);
+  std::ostream filtered_output(&filtered_buffer);
+  size_t input_size = 0;
+  try {
+    input_size = decode_payload(first_byte, input, filtered_output,
+                                header_.payload_size)
+                     .first;
+  } catch (...) {
+    has_checksum = restored_checksum;
+    span = caller_span;
+    kept_memory = 0;
+    throw;
+  }
+  has_checksum = restored_checksum;
+  span = caller_span;
+  kept_memory = 0;
+
+  auto filtered_data = reinterpret_cast<uint8_t const*>(filtered.data());
+  // restored data is allocated only if filtered data can be restored to it
+  if (header_.original_size >
+      header_.filter_.max_restored_size(filtered.size())) {
+    throw std::runtime_error("Incorrect input");
+  }
+  size_t output_size;
+  if (to_span) {
+    if (header_.original_size > span.capacity - span.size) {
+      throw std::runtime_error("Output is too small");
+    }
+    uint8_t* restored = span.data + span.size;
+    {
+      stats_timer timer(collect_stats, stats_.coding_time);
+      output_size = header_.filter_.revert(filtered_data, filtered.size(),
+                                           restored, header_.original_size);
+    }
+    if (has_checksum) {
+      checksum.update(restored, output_size);
+    }
+    span.size += output_size;
+  } else {
+    // restored data is written by chunks of scratch memory of verify, or
+    // of decoded, and then dropped
+    uint8_t* chunk = span.data;
+    size_t chunk_size = span.capacity;
+    if (chunk == nullptr) {
+      decoded.resize(buffer_size + CHARS_COUNT + 2 * BYTE_SIZE);
+      chunk = reinterpret_cast<uint8_t*>(decoded.data());
+      chunk_size = decoded.size();
+    }
+    // writes of chunks are I/O time, not coding time
+    uint64_t io_time = stats_.io_time;
+    {
+      stats_timer timer(collect_stats, stats_.coding_time);
+      output_size = header_.filter_.revert_chunks(
+          filtered_data, filtered.size(), header_.original_size, chunk,
+          chunk_size, [&](size_t size) {
+            if (has_checksum) {
+              checksum.update(chunk, size);
+            }
+            if (span.data == nullptr) {
+              stats_timer io_timer(collect_stats, stats_.io_time);
+              output.write(reinterpret_cast<char const*>(chunk),
+                           static_cast<std::streamsize>(size));
+            }
+          });
+    }
+    stats_.coding_time -= stats_.io_time - io_time;
+  }
+  // symbols are bytes of filtered data
+  stats_.output_bytes += output_size - filtered.size();
+  return {input_size, output_size};
+}
+
+std::pair<size_t, size_t> decoder::decode_payload(uint8_t first_byte,
+                                                  std::istream& input,
+                                                  std::ostream& output,
+                                                  size_t payload_size) {
+  // state of previous stream is dropped, so decoder can be reused
+  codec_.reset();
+  bit_sequence().swap(buffer);
+  if (first_byte == 0) {
+    // empty stream consists of one zero byte
+    ++stats_.input_bytes;
+    return {1, 0};
+  }
+  size_t header_size = get_header_size(first_byte);
+  if (header_size > payload_size) {
+    throw std::runtime_error("Incorrect input");
+  }
+  std::array<uint8_t, MAX_HEADER_SIZE> header; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  header[0] = first_byte;
+  {
+    stats_timer timer(collect_stats, stats_.io_time);
+    input.read(reinterpret_cast<char*>(header.data() + 1),
+               static_cast<std::streamsize>(header_size - 1));
+  }
+  if (static_cast<size_t>(input.gcount()) != header_size - 1) {
+    throw std::runtime_error("Incorrect input");
+  }
+  // leafs count - 1 is the first byte
+  reserve_buffers(codec::memory_usage(first_byte + size_t(1)));
+  read_header(header.data(), header_size);
+  size_t input_size = header_size;
+  size_t output_size = 0;
+  std::array<char, IO_CHUNK_SIZE> chunk; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  while (input_size < payload_size && input) {
+    // reading no more bytes than fit to buffer keeps it within capacity
+    size_t read_size_limit =
+        buffer.size() < buffer_size
+            ? (buffer_size - buffer.size() + BYTE_SIZE - 1) / BYTE_SIZE
+            : 1;
+    {
+      stats_timer timer(collect_stats, stats_.io_time);
+      input.read(chunk.data(),
+                 static_cast<std::streamsize>(std::min(
+                     {chunk.size(), read_size_limit, payload_size - input_size})));
+    }
+    auto read_size = static_cast<size_t>(input.gcount());
+    input_size += read_size;
+    {
+      stats_timer timer(collect_stats, stats_.coding_time);
+      for (size_t i = 0; i < read_size; ++i) {
+        buffer.append(static_cast<uint8_t>(chunk[i]), BYTE_SIZE);
+      }
+    }
+    if (buffer.size() >= buffer_size) {
       output_size += dump_buffer(output);
     }
   }
   output_size += dump_buffer(output);
   if (buffer.size() != end_padding) {
-    throw std::runtime_error("Incorrect input");
+    throw std::runtime_error(span.data != nullptr && span.size == span.capacity
+                                 ? "Output is too small"
+                                 : "Incorrect input");
   }
+  stats_.input_bytes += input_size;
   return {input_size, output_size};
 }
 
 size_t decoder::dump_buffer(std::ostream& output) {
-  auto [idx, write_size] = tree_->dump(buffer, buffer.size() - end_padding, output);
+  ++stats_.buffer_flushes;
+  decoded.clear();
+  size_t write_size = 0;
+  {
+    stats_timer timer(collect_stats, stats_.coding_time);
+    // corrupted stream can have less bits than its padding, it is
+    // rejected after the last flush
+    size_t last_idx =
+        buffer.size() > end_padding ? buffer.size() - end_padding : 0;
+    size_t idx = 0;
+    if (span.data != nullptr) {
+      uint8_t* start = span.data + span.size;
+      std::tie(idx, write_size) = codec_->get_tree().dump(
+          buffer, last_idx, start, span.capacity - span.size);
+      if (has_checksum) {
+        checksum.update(start, write_size);
+      }
+      span.size += write_size;
+      // rest of buffer is longer than any code, but nothing fits
+      if (span.size == span.capacity && last_idx - idx > CHARS_COUNT) {
+        throw std::runtime_error("Output is too small");
+      }
+      if (span.discard) {
+        span.size = 0;
+      }
+    } else {
+      std::tie(idx, write_size) =
+          codec_->get_tree().dump(buffer, last_idx, decoded);
+      if (has_checksum) {
+        checksum.update(reinterpret_cast<uint8_t const*>(decoded.data()),
+                        decoded.size());
+      }
+    }
 
-  bit_sequence new_buffer;
-  for (size_t i = idx; i < buffer.size(); ++i) {
-    new_buffer.append(buffer[i]);
+    buffer.erase_front(idx);
+  }
+  if (span.data == nullptr) {
+    stats_timer timer(collect_stats, stats_.io_time);
+    output.write(decoded.data(), static_cast<std::streamsize>(decoded.size()));
   }
-  buffer.swap(new_buffer);
+  stats_.output_bytes += write_size;
+  stats_.symbols += write_size;
   return write_size;
 }
+
+void decoder::reserve_buffers(size_t codec_memory) {
+  // after writing buffer keeps less than one code and padding, then less
+  // than one byte more than buffer_size is read. Every decoded char takes
+  // at least one bit
+  size_t capacity = buffer_size + CHARS_COUNT + 2 * BYTE_SIZE;
+  size_t required = codec_memory + capacity / BYTE_SIZE +
+                    sizeof(uint64_t) + capacity + IO_CHUNK_SIZE +
+                    MAX_HEADER_SIZE + kept_memory;
+  if (memory_limit == 0) {
+    return;
+  }
+  if (required > memory_limit) {
+    throw std::runtime_error("Memory limit exceeded");
+  }
+  // buffers don't grow by doubling beyond capacity
+  buffer.reserve(capacity);
+  decoded.reserve(capacity);
+}
+
+void decoder::set_buffer_size(size_t bytes) {
+  buffer_size = std::max<size_t>(bytes, 1) * BYTE_SIZE;
+}
+
+void decoder::set_memory_limit(size_t bytes) {
+  memory_limit = bytes;
+}
+
+size_t decoder::get_memory_usage() const {
+  size_t result = buffer.memory_usage() + decoded.capacity() +
+                  filtered.capacity() + IO_CHUNK_SIZE + MAX_HEADER_SIZE;
+  if (codec_ != nullptr) {
+    result += codec_->memory_usage();
+  }
+  return result;
+}
+
+void decoder::enable_stats(bool enable) {
+  collect_stats = enable;
+}
+
+stats const& decoder::get_stats() const {
+  return stats_;
+}
 } // namespace huffman
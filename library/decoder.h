@@ -2,28 +2,126 @@
 
 #include "bit_sequence.h"
 #include "constants.h"
-#include "tree.h"
+#include "crc32c.h"
+#include "stats.h"
 #include <array>
 #include <cstdint>
 #include <istream>
 #include <memory>
 #include <ostream>
+#include <string>
 #include <vector>
 
 namespace huffman {
+struct codec;
+struct frame_header;
+
 struct decoder {
   decoder() = default;
   decoder(decoder const& other) = delete;
   decoder& operator=(decoder const& other) = delete;
   ~decoder() = default;
+  // decodes both legacy and framed streams, for framed ones also checks
+  // original size and checksum, if it is present. Framed stream can consist
+  // of several members, they are decoded one after another. Throws
+  // std::runtime_error if stream ends after continued member
   std::pair<size_t, size_t> decode(std::istream& input, std::ostream& output);
 
-private:
+  // Decodes stream straight to output of capacity bytes, without staging
+  // copies, so size of decoded data must be known, e.g. from frame headers
+  // (see read_members). Returns size of decoded data, throws
+  // std::runtime_error if output is too small
+  size_t decode(std::istream& input, uint8_t* output, size_t capacity);
+
+  // decodes one member of framed stream, even if it is continued, so
+  // members can be decoded independently
+  std::pair<size_t, size_t> decode_member(std::istream& input,
+                                          std::ostream& output);
+
+  // Decode input as decode and decode_member do, with the same checks of
+  // headers, padding and checksums, but decoded chars are only counted and
+  // checksummed, not written anywhere. Return the same sizes
+  std::pair<size_t, size_t> verify(std::istream& input);
+
+  std::pair<size_t, size_t> verify_member(std::istream& input);
+
+  // Times are measured only if enabled, counters are always collected
+  void enable_stats(bool enable = true);
+
+  stats const& get_stats() const;
+
+  // Size of coding buffer in bytes, output is written every time it is full
+  void set_buffer_size(size_t bytes);
+
+  // Limit of memory used by buffers and tables in bytes, 0 means no limit.
+  // decode throws std::runtime_error if it is not enough
+  void set_memory_limit(size_t bytes);
+
+  // Memory used by buffers and tables of the last decoded stream, in bytes
+  size_t get_memory_usage() const;
+
+  // header of stream with 256 chars
+  static constexpr size_t MAX_HEADER_SIZE =
+      ((2 * CHARS_COUNT - 1) * LOG_MAX_NODE_NUMBER + 3 + BYTE_SIZE - 1) /
+          BYTE_SIZE +
+      1;
+
+  using traversal_array = std::array<uint16_t, 2 * CHARS_COUNT - 1>;
+
+  // size of legacy stream header in bytes, header is its first byte only
+  // for empty stream
   static size_t get_header_size(uint8_t first_byte);
-  void read_header(std::vector<uint8_t> const& header);
+
+  // Reads tree traversal from header of non-empty stream, returns its size.
+  // Throws std::runtime_error if nodes are incorrect
+  static size_t read_traversal(uint8_t const* header,
+                               traversal_array& traversal);
+
+  // bits are numbered from lower bit of first byte, as in bit_sequence
+  static uint64_t read_bits(uint8_t const* data, size_t start, size_t count);
+
+private:
+  void read_header(uint8_t const* header, size_t size);
+  std::pair<size_t, size_t> verify_stream(std::istream& input, bool member);
+  // first byte of member must be already read from input
+  std::pair<size_t, size_t> decode_framed(frame_header const& header_,
+                                          std::istream& input,
+                                          std::ostream& output);
+  // filtered payload is decoded to memory and restored from there
+  std::pair<size_t, size_t> decode_filtered(frame_header const& header_,
+                                            uint8_t first_byte,
+                                            std::istream& input,
+                                            std::ostream& output);
+  std::pair<size_t, size_t> decode_payload(uint8_t first_byte,
+                                           std::istream& input,
+                                           std::ostream& output,
+                                           size_t payload_size);
   size_t dump_buffer(std::ostream& output);
-  std::unique_ptr<tree> tree_{nullptr};
+  // Checks memory limit against buffers, codec of codec_memory bytes and
+  // kept_memory, before codec is looked up
+  void reserve_buffers(size_t codec_memory);
+  // shared with other decoders through table_cache
+  std::shared_ptr<codec const> codec_{nullptr};
   bit_sequence buffer;
   uint8_t end_padding{0};
+  std::string decoded;
+  // decoded payload of filtered member, which is restored by chunks
+  std::string filtered;
+  // bytes of whole filtered data of current member
+  size_t kept_memory{0};
+  // caller's output of decode to memory, or scratch memory of verify,
+  // which is overwritten by every flush
+  struct output_span {
+    uint8_t* data{nullptr};
+    size_t capacity{0};
+    size_t size{0};
+    bool discard{false};
+  } span;
+  bool has_checksum{false};
+  crc32c checksum;
+  size_t buffer_size{DEFAULT_BUFFER_SIZE};
+  size_t memory_limit{0};
+  bool collect_stats{false};
+  stats stats_;
 };
 } // namespace huffman
@@ -1,30 +1,67 @@
 #include "encoder.h"
+#include "bit_writer.h"
+#include "frame.h"
+#include "thread_pool.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 #include <string>
 
 namespace huffman {
+namespace {
+// word of output, that can be shared by neighbour chunks of parallel encode
+struct shared_word {
+  size_t index;
+  uint64_t value;
+};
+
+void store(uint8_t* output, size_t index, uint64_t value, size_t output_size) {
+  size_t start = index * sizeof(uint64_t);
+  size_t count = std::min(sizeof(uint64_t), output_size - start);
+  for (size_t i = 0; i < count; ++i) {
+    output[start + i] = static_cast<uint8_t>(value >> (i * BYTE_SIZE));
+  }
+}
+} // namespace
+
 encoder::encoder() {
   counts.fill(0);
 }
 void encoder::add_chars(std::istream& stream) {
-  while (true) {
-    uint8_t ch = stream.get();
-    if (stream.fail()) {
-      break;
+  std::array<char, IO_CHUNK_SIZE> chunk; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  while (stream) {
+    {
+      stats_timer timer(collect_stats, stats_.io_time);
+      stream.read(chunk.data(), chunk.size());
     }
-    add_char(ch);
+    add_chars(reinterpret_cast<uint8_t const*>(chunk.data()),
+              static_cast<size_t>(stream.gcount()));
+  }
+}
+void encoder::add_chars(uint8_t const* data, size_t size) {
+  assert(!is_compiled);
+  stats_timer timer(collect_stats, stats_.counting_time);
+  for (size_t i = 0; i < size; ++i) {
+    ++counts[data[i]];
   }
 }
 void encoder::add_char(uint8_t ch) {
   assert(!is_compiled);
   ++counts[ch];
 }
+void encoder::add_counts(std::array<size_t, CHARS_COUNT> const& counts_) {
+  assert(!is_compiled);
+  for (size_t i = 0; i < CHARS_COUNT; ++i) {
+    counts[i] += counts_[i];
+  }
+}
 
 bit_sequence encoder::encode(std::vector<uint8_t> const& input) {
   if (!is_compiled) {
     compile();
   }
+  std::array<bit_sequence, CHARS_COUNT> const& codes = get_codes();
   bit_sequence result;
   for (uint8_t ch : input) {
     if (codes[ch].size() == 0) {
@@ -37,23 +74,282 @@ bit_sequence encoder::encode(std::vector<uint8_t> const& input) {
   return result;
 }
 void encoder::encode(std::istream& input, std::ostream& output) {
+  encode_payload(input, output, nullptr);
+}
+
+void encoder::encode(uint8_t const* data, size_t size, uint8_t* output,
+                     size_t threads_count) {
+  if (is_empty() && size == 0) {
+    output[0] = 0;
+    ++stats_.output_bytes;
+    return;
+  }
+  if (!is_compiled) {
+    compile();
+  }
+  // wall time of all threads
+  stats_timer timer(collect_stats, stats_.coding_time);
+  size_t chunks_count = (size + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+  std::vector<std::array<size_t, CHARS_COUNT>> histograms(chunks_count);
+  thread_pool pool(std::max<size_t>(std::min(threads_count, chunks_count), 1));
+  auto chunk_size = [&](size_t i) {
+    return std::min(PARALLEL_CHUNK_SIZE, size - i * PARALLEL_CHUNK_SIZE);
+  };
+  for (size_t i = 0; i < chunks_count; ++i) {
+    pool.submit([&, i] {
+      histograms[i].fill(0);
+      uint8_t const* chunk = data + i * PARALLEL_CHUNK_SIZE;
+      for (size_t j = 0; j < chunk_size(i); ++j) {
+        ++histograms[i][chunk[j]];
+      }
+    });
+  }
+  pool.wait();
+
+  // bit offset of every chunk is header size and sizes of previous chunks
+  std::array<bit_sequence, CHARS_COUNT> const& codes = get_codes();
+  std::array<size_t, CHARS_COUNT> total{};
+  std::vector<size_t> offsets(chunks_count + 1, header_size);
+  for (size_t i = 0; i < chunks_count; ++i) {
+    offsets[i + 1] = offsets[i];
+    for (size_t ch = 0; ch < CHARS_COUNT; ++ch) {
+      offsets[i + 1] += histograms[i][ch] * codes[ch].size();
+      total[ch] += histograms[i][ch];
+    }
+  }
+  if (total != counts) {
+    throw std::runtime_error("Input doesn't match added chars");
+  }
+  size_t output_size = get_output_size();
+
+  std::array<uint64_t, CHARS_COUNT> const& values =
+      compiled->get_code_values();
+  std::vector<std::vector<shared_word>> boundaries(chunks_count + 1);
+  {
+    std::vector<shared_word>& boundary = boundaries[chunks_count];
+    bit_writer writer(
+        [&boundary](size_t index, uint64_t value) {
+          boundary.push_back({index, value});
+        },
+        0);
+    writer.write(header());
+    writer.finish();
+  }
+  for (size_t i = 0; i < chunks_count; ++i) {
+    pool.submit([&, i] {
+      // words, that can be shared with other chunks (the first and the
+      // last), are kept in boundary, others are written straight to output
+      std::vector<shared_word>& boundary = boundaries[i];
+      bool finished = false;
+      bit_writer writer(
+          [&](size_t index, uint64_t value) {
+            if (boundary.empty() || finished) {
+              boundary.push_back({index, value});
+            } else {
+              store(output, index, value, (index + 1) * sizeof(uint64_t));
+            }
+          },
+          offsets[i]);
+      uint8_t const* chunk = data + i * PARALLEL_CHUNK_SIZE;
+      for (size_t j = 0; j < chunk_size(i); ++j) {
+        writer.write_code(codes[chunk[j]], values[chunk[j]]);
+      }
+      finished = true;
+      writer.finish();
+    });
+  }
+  pool.wait();
+
+  // words shared by neighbour chunks are stitched, padding bits are zero
+  std::vector<shared_word> words;
+  for (auto const& boundary : boundaries) {
+    words.insert(words.end(), boundary.begin(), boundary.end());
+  }
+  std::sort(words.begin(), words.end(),
+            [](shared_word const& a, shared_word const& b) {
+              return a.index < b.index;
+            });
+  for (size_t i = 0; i < words.size();) {
+    shared_word merged = words[i];
+    for (++i; i < words.size() && words[i].index == merged.index; ++i) {
+      merged.value |= words[i].value;
+    }
+    store(output, merged.index, merged.value, output_size);
+  }
+  stats_.input_bytes += size;
+  stats_.symbols += size;
+  stats_.output_bytes += output_size;
+}
+
+bool encoder::encode_estimated(uint8_t const* data, size_t size,
+                               std::ostream& output, crc32c* checksum) {
+  if (!is_compiled) {
+    compile();
+  }
+  if (is_empty() || size == 0) {
+    if (size != 0) {
+      return false;
+    }
+    counts.fill(0);
+    output.put(0);
+    ++stats_.output_bytes;
+    return true;
+  }
+  std::ostream::pos_type start = output.tellp();
+  if (start == std::ostream::pos_type(-1)) {
+    throw std::runtime_error("Output is not seekable");
+  }
+  // padding of header is known only at the end, so its bits are zero until
+  // they are patched. Bytes with them are kept, as they are already written
+  size_t padding_start = header_size - 3;
+  size_t patch_index = padding_start / BYTE_SIZE;
+  std::array<uint8_t, 2> patched{};
+  size_t written = 0;
+  auto flush = [&](size_t count) {
+    if (written == 0) {
+      for (size_t i = 0; i < patched.size(); ++i) {
+        if (patch_index + i < count) {
+          patched[i] = static_cast<uint8_t>(encoded[patch_index + i]);
+        }
+      }
+    }
+    stats_timer timer(collect_stats, stats_.io_time);
+    output.write(encoded.data(), static_cast<std::streamsize>(count));
+    written += count;
+    encoded.clear();
+  };
+  encoded.clear();
+  bit_writer writer(
+      [&](size_t index, uint64_t word) {
+        string_sink{encoded}(index, word);
+        if (encoded.size() >= IO_CHUNK_SIZE) {
+          flush(encoded.size());
+        }
+      },
+      0);
+  writer.write(compiled->get_tree().header());
+  writer.write(0, 3);
+  std::array<bit_sequence, CHARS_COUNT> const& codes = get_codes();
+  std::array<uint64_t, CHARS_COUNT> const& values =
+      compiled->get_code_values();
+  std::array<size_t, CHARS_COUNT> exact{};
+  {
+    stats_timer timer(collect_stats, stats_.coding_time);
+    for (size_t first = 0; first < size; first += IO_CHUNK_SIZE) {
+      size_t chunk_size = std::min(IO_CHUNK_SIZE, size - first);
+      if (checksum != nullptr) {
+        checksum->update(data + first, chunk_size);
+      }
+      for (size_t i = first; i < first + chunk_size; ++i) {
+        bit_sequence const& code = codes[data[i]];
+        if (code.size() == 0) {
+          return false;
+        }
+        ++exact[data[i]];
+        writer.write_code(code, values[data[i]]);
+      }
+    }
+  }
+  size_t bits = writer.position();
+  writer.finish();
+  size_t output_size = (bits + BYTE_SIZE - 1) / BYTE_SIZE;
+  flush(output_size - written);
+  counts = exact;
+  assert(output_size == get_output_size());
+
+  uint8_t padding = (BYTE_SIZE - bits % BYTE_SIZE) % BYTE_SIZE;
+  size_t shift = padding_start % BYTE_SIZE;
+  patched[0] = static_cast<uint8_t>(patched[0] | (padding << shift));
+  size_t patched_count = 1;
+  if (shift + 3 > BYTE_SIZE) {
+    patched[1] =
+        static_cast<uint8_t>(patched[1] | (padding >> (BYTE_SIZE - shift)));
+    patched_count = 2;
+  }
+  std::ostream::pos_type end = output.tellp();
+  output.seekp(start + static_cast<std::streamoff>(patch_index));
+  output.write(reinterpret_cast<char const*>(patched.data()),
+               static_cast<std::streamsize>(patched_count));
+  output.seekp(end);
+  if (!output) {
+    throw std::runtime_error("Output can't be written");
+  }
+  stats_.input_bytes += size;
+  stats_.symbols += size;
+  stats_.output_bytes += output_size;
+  return true;
+}
+
+void encoder::encode_framed(std::istream& input, std::ostream& output,
+                            uint8_t flags) {
+  if (!is_compiled) {
+    compile();
+  }
+  // member isn't started if it can't be finished
+  check_memory_limit();
+  frame_header header_;
+  header_.flags = flags;
+  {
+    stats_timer timer(collect_stats, stats_.header_time);
+    header_.original_size = get_input_size();
+    header_.payload_size = get_output_size();
+    header_.write(output);
+  }
+
+  if (header_.has_flag(FRAME_FLAG_CHECKSUM)) {
+    crc32c checksum;
+    encode_payload(input, output, &checksum);
+    write_number(output, checksum.value(), FRAME_TRAILER_SIZE);
+  } else {
+    encode_payload(input, output, nullptr);
+  }
+  stats_.output_bytes += header_.header_size() + header_.trailer_size();
+}
+
+void encoder::encode_payload(std::istream& input, std::ostream& output,
+                             crc32c* checksum) {
   if (is_empty()) {
     output.put(0);
+    ++stats_.output_bytes;
     return;
   }
 
   if (!is_compiled) {
     compile();
   }
-  bit_sequence buffer(header());
-  while (true) {
-    uint8_t ch = input.get();
-    if (input.fail()) {
-      break;
+  std::array<bit_sequence, CHARS_COUNT> const& codes = get_codes();
+  bit_sequence buffer;
+  if (memory_limit != 0) {
+    check_memory_limit();
+    // buffers don't grow by doubling beyond capacity
+    buffer.reserve(buffer_capacity());
+    encoded.reserve(buffer_capacity() / BYTE_SIZE);
+  }
+  {
+    stats_timer timer(collect_stats, stats_.header_time);
+    buffer.append(header());
+  }
+  std::array<char, IO_CHUNK_SIZE> chunk; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  while (input) {
+    {
+      stats_timer timer(collect_stats, stats_.io_time);
+      input.read(chunk.data(), static_cast<std::streamsize>(
+                                   next_read_size(buffer.size())));
     }
-    buffer.append(codes[ch]);
-
-    if (buffer.size() > MAX_BUFFER_SIZE) {
+    auto read_size = static_cast<size_t>(input.gcount());
+    stats_.input_bytes += read_size;
+    stats_.symbols += read_size;
+    {
+      stats_timer timer(collect_stats, stats_.coding_time);
+      if (checksum != nullptr) {
+        checksum->update(reinterpret_cast<uint8_t const*>(chunk.data()),
+                         read_size);
+      }
+      for (size_t i = 0; i < read_size; ++i) {
+        buffer.append(codes[static_cast<uint8_t>(chunk[i])]);
+      }
+    }
+    if (buffer.size() >= buffer_size) {
       dump_buffer(buffer, output);
     }
   }
@@ -70,7 +366,8 @@ bit_sequence encoder::header() const {
     result.append(0, BYTE_SIZE);
     return result;
   }
-  bit_sequence result = tree(counts).header();
+  bit_sequence result = compiled != nullptr ? compiled->get_tree().header()
+                                            : tree(counts).header();
 
   // add padding
   uint8_t size_mod_8 = (result.size() + 3) % BYTE_SIZE;
@@ -83,9 +380,65 @@ bit_sequence encoder::header() const {
 }
 
 void encoder::compile() {
-  tree tree_(counts);
-  tree_.get_codes(codes);
+  stats_timer timer(collect_stats, stats_.tree_build_time);
+  if (!is_empty()) {
+    compiled = std::make_shared<codec const>(counts);
+    header_size = header().size();
+    for (bit_sequence const& code : compiled->get_codes()) {
+      max_code_size = std::max(max_code_size, code.size());
+    }
+  }
   is_compiled = true;
+  // codes are small, buffers are allocated only after that check
+  check_memory_limit();
+}
+
+std::shared_ptr<codec const> encoder::get_codec() const {
+  return compiled;
+}
+
+std::array<bit_sequence, CHARS_COUNT> const& encoder::get_codes() const {
+  static std::array<bit_sequence, CHARS_COUNT> const empty;
+  return compiled != nullptr ? compiled->get_codes() : empty;
+}
+
+void encoder::check_memory_limit() const {
+  if (memory_limit != 0 && get_memory_usage() > memory_limit) {
+    throw std::runtime_error("Memory limit exceeded");
+  }
+}
+
+void encoder::set_buffer_size(size_t bytes) {
+  buffer_size = std::max<size_t>(bytes, 1) * BYTE_SIZE;
+}
+
+void encoder::set_memory_limit(size_t bytes) {
+  memory_limit = bytes;
+}
+
+size_t encoder::get_memory_usage() const {
+  size_t result = IO_CHUNK_SIZE;
+  if (compiled != nullptr) {
+    result += compiled->memory_usage();
+  }
+  // coding buffer and bytes, that are written from it
+  result += 2 * (buffer_capacity() / BYTE_SIZE + sizeof(uint64_t));
+  return result;
+}
+
+size_t encoder::buffer_capacity() const {
+  // buffer is written when it is full, so it exceeds buffer_size by less
+  // than one code and padding. Header is appended to buffer at once
+  return std::max(buffer_size, header_size) + max_code_size + BYTE_SIZE;
+}
+
+size_t encoder::next_read_size(size_t buffered) const {
+  // every read char takes no more than max_code_size bits
+  if (buffered >= buffer_size) {
+    return 1;
+  }
+  return std::clamp<size_t>((buffer_size - buffered) / max_code_size, 1,
+                            IO_CHUNK_SIZE);
 }
 
 bool encoder::is_empty() const {
@@ -98,6 +451,7 @@ bool encoder::is_empty() const {
 }
 
 uint8_t encoder::count_size_mod_8() const {
+  std::array<bit_sequence, CHARS_COUNT> const& codes = get_codes();
   uint8_t result = 0;
   for (size_t i = 0; i < CHARS_COUNT; ++i) {
     // to prevent size_t overflow, if counts[i] is >
@@ -109,17 +463,20 @@ uint8_t encoder::count_size_mod_8() const {
 }
 
 void encoder::dump_buffer(bit_sequence& buffer, std::ostream& output) {
-  for (size_t i = 0; i < buffer.size() / BYTE_SIZE; ++i) {
-    output.put(static_cast<char>(buffer.get_number(BYTE_SIZE, i * BYTE_SIZE)));
-  }
+  ++stats_.buffer_flushes;
+  {
+    stats_timer timer(collect_stats, stats_.coding_time);
+    encoded.resize(buffer.size() / BYTE_SIZE);
+    for (size_t i = 0; i < encoded.size(); ++i) {
+      encoded[i] =
+          static_cast<char>(buffer.get_number(BYTE_SIZE, i * BYTE_SIZE));
+    }
 
-  bit_sequence new_buffer;
-  for (size_t i = buffer.size() / BYTE_SIZE * BYTE_SIZE; i < buffer.size();
-       ++i) {
-    new_buffer.append(buffer[i]);
+    buffer.erase_front(encoded.size() * BYTE_SIZE);
   }
-
-  buffer.swap(new_buffer);
+  stats_timer timer(collect_stats, stats_.io_time);
+  output.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+  stats_.output_bytes += encoded.size();
 }
 size_t encoder::get_input_size() const {
   size_t result = 0;
@@ -128,7 +485,31 @@ size_t encoder::get_input_size() const {
   }
   return result;
 }
+std::array<size_t, CHARS_COUNT> const& encoder::get_counts() const {
+  return counts;
+}
+size_t encoder::get_output_size(
+    std::array<size_t, CHARS_COUNT> const& counts) {
+  std::array<uint8_t, CHARS_COUNT> lengths; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  tree::get_code_lengths(counts, lengths);
+  size_t leafs_count = 0;
+  size_t result = 0;
+  for (size_t i = 0; i < CHARS_COUNT; ++i) {
+    leafs_count += lengths[i] != 0 ? 1 : 0;
+    result += counts[i] * lengths[i];
+  }
+  if (leafs_count == 0) {
+    // empty stream consists of one zero byte
+    return 1;
+  }
+  // tree with one char has two equal leafs, see tree::header
+  leafs_count = std::max<size_t>(leafs_count, 2);
+  result += BYTE_SIZE + (2 * leafs_count - 1) * LOG_MAX_NODE_NUMBER + 3;
+  return (result + BYTE_SIZE - 1) / BYTE_SIZE;
+}
+
 size_t encoder::get_output_size() const {
+  std::array<bit_sequence, CHARS_COUNT> const& codes = get_codes();
   size_t result = 0;
   size_t cur = header().size();
 
@@ -140,4 +521,24 @@ size_t encoder::get_output_size() const {
   result += (cur + BYTE_SIZE - 1) / BYTE_SIZE;
   return result;
 }
+void encoder::enable_stats(bool enable) {
+  collect_stats = enable;
+}
+
+stats const& encoder::get_stats() const {
+  return stats_;
+}
+
+double encoder::get_entropy() const {
+  size_t input_size = get_input_size();
+  double result = 0;
+  for (size_t cnt : counts) {
+    if (cnt != 0) {
+      double probability =
+          static_cast<double>(cnt) / static_cast<double>(input_size);
+      result -= probability * std::log2(probability);
+    }
+  }
+  return result;
+}
 } // namespace huffman
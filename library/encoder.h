@@ -1,12 +1,16 @@
 #pragma once
 
 #include "bit_sequence.h"
+#include "codec.h"
 #include "constants.h"
-#include "tree.h"
+#include "crc32c.h"
+#include "stats.h"
 #include <array>
 #include <cstdint>
 #include <istream>
+#include <memory>
 #include <ostream>
+#include <string>
 #include <vector>
 
 namespace huffman {
@@ -21,9 +25,37 @@ struct encoder {
 
   void add_chars(std::istream& stream);
 
+  void add_chars(uint8_t const* data, size_t size);
+
   void add_char(uint8_t ch);
 
+  // adds counts of all chars at once, they can be estimated, see
+  // encode_estimated
+  void add_counts(std::array<size_t, CHARS_COUNT> const& counts_);
+
   void encode(std::istream& input, std::ostream& output);
+
+  // Encodes data, which chars were added from, to legacy stream in output
+  // of get_output_size() bytes, byte-identical to encode. Chunks of data are
+  // encoded on threads_count threads at bit offsets known from their
+  // histograms. Throws std::runtime_error if data doesn't match added chars
+  void encode(uint8_t const* data, size_t size, uint8_t* output,
+              size_t threads_count);
+
+  // Encodes data to legacy stream in output in one pass with codes of added
+  // counts, which can be estimated, e.g. by sample_counts. Codes are written
+  // to output as they are produced, padding of header is patched at the
+  // end, so output must be seekable. Then counts are replaced by exact
+  // counts of data, so sizes are exact. Returns false and keeps counts if
+  // data has a char without code, output has a part of stream then.
+  // checksum is updated by data if it is given
+  bool encode_estimated(uint8_t const* data, size_t size, std::ostream& output,
+                        crc32c* checksum = nullptr);
+
+  // writes framed stream member with original size, flags are FRAME_FLAG_*,
+  // checksum is computed only if it is requested, see frame.h
+  void encode_framed(std::istream& input, std::ostream& output,
+                     uint8_t flags = FRAME_FLAG_CHECKSUM);
   // used only for tests
   bit_sequence encode(std::vector<uint8_t> const& input);
 
@@ -32,18 +64,69 @@ struct encoder {
   // It is correct only after added all chars from input
   size_t get_input_size() const;
 
+  std::array<size_t, CHARS_COUNT> const& get_counts() const;
+
   // It is correct only after compile
   size_t get_output_size() const;
 
-private:
+  // Exact size of legacy stream with given counts, tree is not built
+  static size_t get_output_size(std::array<size_t, CHARS_COUNT> const& counts);
+
+  // Shannon entropy of added chars in bits per char
+  double get_entropy() const;
+
+  // Times are measured only if enabled, counters are always collected
+  void enable_stats(bool enable = true);
+
+  stats const& get_stats() const;
+
+  // Size of coding buffer in bytes, output is written every time it is full
+  void set_buffer_size(size_t bytes);
+
+  // Limit of memory used by buffers and tables in bytes, 0 means no limit.
+  // encode throws std::runtime_error if it is not enough
+  void set_memory_limit(size_t bytes);
+
+  // Memory needed by buffers and tables to encode, in bytes.
+  // It is correct only after compile
+  size_t get_memory_usage() const;
+
+  // Builds codes for added chars. Called by encode, can be called before it
+  // to know exact output size without encoding
   void compile();
 
-  static void dump_buffer(bit_sequence& buffer, std::ostream& output);
+  // Codes of added chars, which can be shared with encode and decode
+  // sessions. It is correct only after compile, nullptr if no chars added
+  std::shared_ptr<codec const> get_codec() const;
+
+private:
+
+  void encode_payload(std::istream& input, std::ostream& output,
+                      crc32c* checksum);
+
+  void dump_buffer(bit_sequence& buffer, std::ostream& output);
+
+  // maximal number of bits in coding buffer
+  size_t buffer_capacity() const;
+  size_t next_read_size(size_t buffered) const;
+
+  // throws std::runtime_error if memory limit is less than memory usage
+  void check_memory_limit() const;
+
+  // codes of compiled codec, empty if it isn't built
+  std::array<bit_sequence, CHARS_COUNT> const& get_codes() const;
 
   bool is_empty() const;
   uint8_t count_size_mod_8() const;
   bool is_compiled{false};
-  std::array<bit_sequence, CHARS_COUNT> codes;
+  std::shared_ptr<codec const> compiled{nullptr};
   std::array<size_t, CHARS_COUNT> counts{};
+  std::string encoded;
+  size_t header_size{0};
+  size_t max_code_size{0};
+  size_t buffer_size{DEFAULT_BUFFER_SIZE};
+  size_t memory_limit{0};
+  bool collect_stats{false};
+  stats stats_;
 };
 } // namespace huffman
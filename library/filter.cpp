@@ -0,0 +1,317 @@
+#include "filter.h"
+#include "crc32c.h"
+#include "encoder.h"
+#include "frame.h"
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+
+namespace huffman {
+namespace {
+// further repeats of two equal bytes are counted by one byte
+constexpr size_t MAX_RUN_REPEATS = 255;
+
+size_t apply_rle(uint8_t const* data, size_t size, uint8_t* output) {
+  size_t position = 0;
+  size_t i = 0;
+  while (i < size) {
+    uint8_t byte = data[i++];
+    output[position++] = byte;
+    if (i < size && data[i] == byte) {
+      output[position++] = byte;
+      ++i;
+      uint8_t const* end = data + std::min(size, i + MAX_RUN_REPEATS);
+      uint8_t const* run_end = std::find_if(
+          data + i, end, [byte](uint8_t ch) { return ch != byte; });
+      output[position++] = static_cast<uint8_t>(run_end - (data + i));
+      i = run_end - data;
+    }
+  }
+  return position;
+}
+
+size_t revert_rle(uint8_t const* data, size_t size, uint8_t* output,
+                  size_t capacity) {
+  size_t position = 0;
+  size_t i = 0;
+  while (i < size) {
+    uint8_t byte = data[i++];
+    size_t count = 1;
+    if (i < size && data[i] == byte) {
+      // pair must be followed by count of repeats
+      if (i + 1 == size) {
+        throw std::runtime_error("Incorrect input");
+      }
+      count = 2 + data[i + 1];
+      i += 2;
+    }
+    if (count > capacity - position) {
+      throw std::runtime_error("Incorrect input");
+    }
+    std::fill_n(output + position, count, byte);
+    position += count;
+  }
+  return position;
+}
+
+// loops over bytes of one record have no dependencies, so they are
+// vectorized by compiler
+void apply_delta(uint8_t const* data, size_t size, size_t width,
+                 uint8_t* output) {
+  size_t head = std::min(size, width);
+  std::copy_n(data, head, output);
+  for (size_t i = head; i < size; ++i) {
+    output[i] = static_cast<uint8_t>(data[i] - data[i - width]);
+  }
+}
+
+void revert_delta(uint8_t const* data, size_t size, size_t width,
+                  uint8_t* output) {
+  size_t head = std::min(size, width);
+  std::copy_n(data, head, output);
+  for (size_t start = head; start < size; start += width) {
+    size_t end = std::min(size, start + width);
+    for (size_t i = start; i < end; ++i) {
+      output[i] = static_cast<uint8_t>(data[i] + output[i - width]);
+    }
+  }
+}
+
+// bytes after the last whole record are kept in place
+void apply_shuffle(uint8_t const* data, size_t size, size_t width,
+                   uint8_t* output) {
+  size_t records = size / width;
+  for (size_t j = 0; j < width; ++j) {
+    uint8_t* lane = output + j * records;
+    for (size_t i = 0; i < records; ++i) {
+      lane[i] = data[i * width + j];
+    }
+  }
+  std::copy_n(data + records * width, size - records * width,
+              output + records * width);
+}
+
+void revert_shuffle(uint8_t const* data, size_t size, size_t width,
+                    uint8_t* output) {
+  size_t records = size / width;
+  for (size_t j = 0; j < width; ++j) {
+    uint8_t const* lane = data + j * records;
+    for (size_t i = 0; i < records; ++i) {
+      output[i * width + j] = lane[i];
+    }
+  }
+  std::copy_n(data + records * width, size - records * width,
+              output + records * width);
+}
+} // namespace
+
+void filter::validate() const {
+  if (type > filter_type::shuffle) {
+    throw std::runtime_error("Unsupported format features");
+  }
+  bool has_width = type == filter_type::delta || type == filter_type::shuffle;
+  if (width == 0 || (!has_width && width != 1)) {
+    throw std::runtime_error("Incorrect input");
+  }
+}
+
+size_t filter::max_filtered_size(size_t size) const {
+  // every pair of equal bytes takes three bytes
+  return type == filter_type::rle ? size + (size + 1) / 2 : size;
+}
+
+size_t filter::max_restored_size(size_t size) const {
+  if (type != filter_type::rle) {
+    return size;
+  }
+  // bound of untrusted size saturates instead of overflow
+  if (size / 3 > (SIZE_MAX - 2) / (2 + MAX_RUN_REPEATS)) {
+    return SIZE_MAX;
+  }
+  // every three bytes of pair and count are restored to the longest run
+  return size / 3 * (2 + MAX_RUN_REPEATS) + size % 3;
+}
+
+void filter::apply(uint8_t const* data, size_t size,
+                   std::string& output) const {
+  output.resize(max_filtered_size(size));
+  auto result = reinterpret_cast<uint8_t*>(output.data());
+  switch (type) {
+  case filter_type::none:
+    std::copy_n(data, size, result);
+    break;
+  case filter_type::rle:
+    output.resize(apply_rle(data, size, result));
+    break;
+  case filter_type::delta:
+    apply_delta(data, size, width, result);
+    break;
+  case filter_type::shuffle:
+    apply_shuffle(data, size, width, result);
+    break;
+  }
+}
+
+size_t filter::revert(uint8_t const* data, size_t size, uint8_t* output,
+                      size_t capacity) const {
+  if (type == filter_type::rle) {
+    return revert_rle(data, size, output, capacity);
+  }
+  if (size > capacity) {
+    throw std::runtime_error("Incorrect input");
+  }
+  if (type == filter_type::delta) {
+    revert_delta(data, size, width, output);
+  } else if (type == filter_type::shuffle) {
+    revert_shuffle(data, size, width, output);
+  } else {
+    std::copy_n(data, size, output);
+  }
+  return size;
+}
+
+size_t filter::revert_chunks(uint8_t const* data, size_t size,
+                             size_t capacity, uint8_t* chunk,
+                             size_t chunk_size,
+                             std::function<void(size_t)> const& on_chunk) const {
+  if (chunk_size < 2 + MAX_RUN_REPEATS) {
+    throw std::invalid_argument("Chunk is too small");
+  }
+  if (type == filter_type::rle) {
+    size_t position = 0;
+    size_t total = 0;
+    size_t i = 0;
+    while (i < size) {
+      uint8_t byte = data[i++];
+      size_t count = 1;
+      if (i < size && data[i] == byte) {
+        if (i + 1 == size) {
+          throw std::runtime_error("Incorrect input");
+        }
+        count = 2 + data[i + 1];
+        i += 2;
+      }
+      if (count > capacity - total) {
+        throw std::runtime_error("Incorrect input");
+      }
+      if (count > chunk_size - position) {
+        on_chunk(position);
+        position = 0;
+      }
+      std::fill_n(chunk + position, count, byte);
+      position += count;
+      total += count;
+    }
+    if (position != 0) {
+      on_chunk(position);
+    }
+    return total;
+  }
+  if (size > capacity) {
+    throw std::runtime_error("Incorrect input");
+  }
+  size_t records = size / width;
+  // restored bytes before chunk, which delta of its head refers to
+  std::array<uint8_t, UINT8_MAX> tail{};
+  for (size_t start = 0; start < size; start += chunk_size) {
+    size_t end = std::min(size, start + chunk_size);
+    if (type == filter_type::delta) {
+      for (size_t i = start; i < end; ++i) {
+        size_t k = i - start;
+        uint8_t previous = 0;
+        if (k >= width) {
+          previous = chunk[k - width];
+        } else if (i >= width) {
+          previous = tail[k];
+        }
+        chunk[k] = static_cast<uint8_t>(data[i] + previous);
+      }
+      if (end - start >= width) {
+        std::copy_n(chunk + (end - start) - width, width, tail.begin());
+      }
+    } else if (type == filter_type::shuffle) {
+      size_t record = start / width;
+      size_t lane = start % width;
+      for (size_t i = start; i < end; ++i) {
+        chunk[i - start] =
+            i < records * width ? data[lane * records + record] : data[i];
+        if (++lane == width) {
+          lane = 0;
+          ++record;
+        }
+      }
+    } else {
+      std::copy(data + start, data + end, chunk);
+    }
+    on_chunk(end - start);
+  }
+  return size;
+}
+
+filter filter::parse(std::string const& name) {
+  size_t colon = name.find(':');
+  std::string type_name = name.substr(0, colon);
+  filter result;
+  if (type_name == "rle") {
+    result.type = filter_type::rle;
+  } else if (type_name == "delta") {
+    result.type = filter_type::delta;
+  } else if (type_name == "shuffle") {
+    result.type = filter_type::shuffle;
+    result.width = 4;
+  } else {
+    throw std::runtime_error("Unknown filter " + name);
+  }
+  if (colon != std::string::npos) {
+    std::string width = name.substr(colon + 1);
+    if (width.empty() || width.size() > 3 ||
+        width.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoul(width) > UCHAR_MAX) {
+      throw std::runtime_error("Incorrect width of filter " + name);
+    }
+    result.width = static_cast<uint8_t>(std::stoul(width));
+  }
+  try {
+    result.validate();
+  } catch (std::runtime_error const&) {
+    throw std::runtime_error("Incorrect width of filter " + name);
+  }
+  return result;
+}
+
+size_t encode_filtered(uint8_t const* data, size_t size, filter const& filter_,
+                       std::ostream& output, uint8_t flags) {
+  uint8_t const* coded = data;
+  size_t coded_size = size;
+  std::string filtered;
+  if (filter_.type != filter_type::none) {
+    filter_.apply(data, size, filtered);
+    coded = reinterpret_cast<uint8_t const*>(filtered.data());
+    coded_size = filtered.size();
+    flags |= FRAME_FLAG_FILTER;
+  }
+  encoder encoder_;
+  encoder_.add_chars(coded, coded_size);
+  std::stringstream stream;
+  // counts are exact, so every char has code
+  encoder_.encode_estimated(coded, coded_size, stream);
+
+  frame_header header_;
+  header_.flags = flags;
+  header_.filter_ = filter_;
+  header_.original_size = size;
+  header_.payload_size = encoder_.get_output_size();
+  header_.write(output);
+  output << stream.rdbuf();
+  // checksum is computed over original data, as for other members
+  if (header_.has_flag(FRAME_FLAG_CHECKSUM)) {
+    crc32c checksum;
+    checksum.update(data, size);
+    write_number(output, checksum.value(), FRAME_TRAILER_SIZE);
+  }
+  return header_.payload_size + frame_overhead(flags);
+}
+} // namespace huffman
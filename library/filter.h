@@ -0,0 +1,63 @@
+#pragma once
+
+#include "constants.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace huffman {
+enum class filter_type : uint8_t {
+  none = 0,
+  // two equal bytes are followed by count of their further repeats
+  rle = 1,
+  // every byte is replaced with difference with byte width bytes before it
+  delta = 2,
+  // records of width bytes are transposed, so their first bytes go first
+  shuffle = 3,
+};
+
+// Transform applied to data before coding, so it has less symbols or they
+// are more predictable. Decoded data is restored by its inverse
+struct filter {
+  filter_type type{filter_type::none};
+  // size of record in bytes for delta and shuffle, 1 for others
+  uint8_t width{1};
+
+  // throws std::runtime_error for unknown type or incorrect width
+  void validate() const;
+
+  // filtered data of size bytes is not bigger than that
+  size_t max_filtered_size(size_t size) const;
+
+  // data restored from size filtered bytes is not bigger than that
+  size_t max_restored_size(size_t size) const;
+
+  // replaces output with filtered data
+  void apply(uint8_t const* data, size_t size, std::string& output) const;
+
+  // Restores filtered data to output of capacity bytes, returns size of
+  // restored data. Throws std::runtime_error if data is incorrect or
+  // restored data doesn't fit
+  size_t revert(uint8_t const* data, size_t size, uint8_t* output,
+                size_t capacity) const;
+
+  // Restores filtered data like revert, but by chunks of at most chunk_size
+  // bytes, which are written to chunk and passed to on_chunk by their size,
+  // so restored data isn't kept whole. chunk_size must fit the longest run
+  size_t revert_chunks(uint8_t const* data, size_t size, size_t capacity,
+                       uint8_t* chunk, size_t chunk_size,
+                       std::function<void(size_t)> const& on_chunk) const;
+
+  // "rle", "delta" or "shuffle", width of two last ones can follow colon,
+  // e.g. "delta:4". Throws std::runtime_error for incorrect names
+  static filter parse(std::string const& name);
+};
+
+// Writes data as framed member with FRAME_FLAG_* flags, data is filtered
+// before coding. Returns size of written member
+size_t encode_filtered(uint8_t const* data, size_t size, filter const& filter_,
+                       std::ostream& output,
+                       uint8_t flags = FRAME_FLAG_CHECKSUM);
+} // namespace huffman
@@ -0,0 +1,218 @@
+#include "frame.h"
+#include <array>
+#include <limits>
+#include <stdexcept>
+
+namespace huffman {
+void write_number(std::ostream& output, uint64_t number, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    output.put(static_cast<char>(number & 0xFFu));
+    number >>= BYTE_SIZE;
+  }
+}
+
+uint64_t read_number(std::istream& input, size_t size) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < size; ++i) {
+    uint64_t byte = static_cast<uint8_t>(input.get());
+    result |= byte << (i * BYTE_SIZE);
+  }
+  if (input.fail()) {
+    throw std::runtime_error("Incorrect input");
+  }
+  return result;
+}
+
+uint64_t read_number(uint8_t const* data, size_t size) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < size; ++i) {
+    result |= static_cast<uint64_t>(data[i]) << (i * BYTE_SIZE);
+  }
+  return result;
+}
+
+bool frame_header::has_flag(uint8_t flag) const {
+  return (flags & flag) != 0;
+}
+
+size_t frame_header::header_size() const {
+  if (version == 1) {
+    return FRAME_V1_HEADER_SIZE;
+  }
+  return FRAME_HEADER_SIZE +
+         (has_flag(FRAME_FLAG_FILTER) ? FRAME_FILTER_SIZE : 0);
+}
+
+size_t frame_header::trailer_size() const {
+  return has_flag(FRAME_FLAG_CHECKSUM) ? FRAME_TRAILER_SIZE : 0;
+}
+
+uint64_t frame_header::max_original_size() const {
+  // every symbol takes at least one bit, bound saturates instead of overflow
+  uint64_t symbols =
+      payload_size > std::numeric_limits<uint64_t>::max() / BYTE_SIZE
+          ? std::numeric_limits<uint64_t>::max()
+          : payload_size * BYTE_SIZE;
+  return has_flag(FRAME_FLAG_FILTER) ? filter_.max_restored_size(symbols)
+                                     : symbols;
+}
+
+size_t frame_overhead(uint8_t flags) {
+  frame_header header;
+  header.flags = flags;
+  return header.header_size() + header.trailer_size();
+}
+
+void frame_header::write(std::ostream& output) const {
+  for (uint8_t byte : FRAME_MAGIC) {
+    output.put(static_cast<char>(byte));
+  }
+  output.put(static_cast<char>(FRAME_VERSION));
+  output.put(static_cast<char>(flags));
+  write_number(output, original_size, 8);
+  write_number(output, payload_size, 8);
+  if (has_flag(FRAME_FLAG_FILTER)) {
+    output.put(static_cast<char>(filter_.type));
+    output.put(static_cast<char>(filter_.width));
+  }
+}
+
+frame_header frame_header::read(std::istream& input) {
+  // magic and version are read first, as header size depends on version,
+  // and then filter, if flags have it
+  std::array<uint8_t, FRAME_HEADER_SIZE + FRAME_FILTER_SIZE> data; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  data[0] = FRAME_MAGIC[0];
+  size_t size = FRAME_MAGIC.size() + 1;
+  input.read(reinterpret_cast<char*>(data.data() + 1),
+             static_cast<std::streamsize>(size - 1));
+  if (static_cast<size_t>(input.gcount()) == size - 1) {
+    size_t rest_size =
+        (data[size - 1] == 1 ? FRAME_V1_HEADER_SIZE : FRAME_HEADER_SIZE) -
+        size;
+    input.read(reinterpret_cast<char*>(data.data() + size),
+               static_cast<std::streamsize>(rest_size));
+    size += static_cast<size_t>(input.gcount());
+    if (size == FRAME_HEADER_SIZE &&
+        (data[FRAME_MAGIC.size() + 1] & FRAME_FLAG_FILTER) != 0) {
+      input.read(reinterpret_cast<char*>(data.data() + size),
+                 static_cast<std::streamsize>(FRAME_FILTER_SIZE));
+      size += static_cast<size_t>(input.gcount());
+    }
+  }
+  return parse(data.data(), size);
+}
+
+frame_header frame_header::parse(uint8_t const* data, size_t size) {
+  if (size < FRAME_MAGIC.size() + 1) {
+    throw std::runtime_error("Incorrect input");
+  }
+  for (size_t i = 0; i < FRAME_MAGIC.size(); ++i) {
+    if (data[i] != FRAME_MAGIC[i]) {
+      throw std::runtime_error("Incorrect input");
+    }
+  }
+  frame_header result;
+  result.version = data[FRAME_MAGIC.size()];
+  if (result.version != 1 && result.version != FRAME_VERSION) {
+    throw std::runtime_error("Unsupported format version");
+  }
+  if (size < result.header_size()) {
+    throw std::runtime_error("Incorrect input");
+  }
+  size_t position = FRAME_MAGIC.size() + 1;
+  if (result.version != 1) {
+    result.flags = data[position++];
+    if ((result.flags & ~FRAME_KNOWN_FLAGS) != 0) {
+      throw std::runtime_error("Unsupported format features");
+    }
+  }
+  // filter follows sizes
+  if (size < result.header_size()) {
+    throw std::runtime_error("Incorrect input");
+  }
+  result.original_size = read_number(data + position, 8);
+  result.payload_size = read_number(data + position + 8, 8);
+  if (result.has_flag(FRAME_FLAG_FILTER)) {
+    result.filter_.type = static_cast<filter_type>(data[position + 16]);
+    result.filter_.width = data[position + 17];
+    result.filter_.validate();
+  }
+  // output of original size is allocated before payload is decoded
+  if (result.original_size > result.max_original_size()) {
+    throw std::runtime_error("Incorrect input");
+  }
+  return result;
+}
+
+uint64_t frame_member::size() const {
+  return header.header_size() + header.payload_size + header.trailer_size();
+}
+
+std::vector<frame_member> read_members(std::istream& input) {
+  std::vector<frame_member> result;
+  std::streamoff start = input.tellg();
+  uint8_t first_byte = input.get();
+  if (first_byte != FRAME_MAGIC[0] ||
+      input.peek() == std::char_traits<char>::eof()) {
+    return result;
+  }
+  uint64_t offset = 0;
+  while (true) {
+    if (first_byte != FRAME_MAGIC[0]) {
+      throw std::runtime_error("Incorrect input");
+    }
+    result.push_back({offset, frame_header::read(input)});
+    offset += result.back().size();
+    input.seekg(start + static_cast<std::streamoff>(offset));
+    first_byte = input.get();
+    if (input.fail()) {
+      break;
+    }
+  }
+  if (result.back().header.has_flag(FRAME_FLAG_CONTINUED)) {
+    throw std::runtime_error("Incorrect input");
+  }
+  input.clear();
+  input.seekg(0, std::ios::end);
+  if (input.tellg() < start + static_cast<std::streamoff>(offset)) {
+    throw std::runtime_error("Incorrect input");
+  }
+  return result;
+}
+
+std::vector<frame_member> read_complete_members(std::istream& input) {
+  std::streamoff start = input.tellg();
+  std::vector<frame_member> result = read_members(input);
+  if (result.empty()) {
+    throw std::runtime_error("Legacy stream has no members");
+  }
+  input.clear();
+  input.seekg(0, std::ios::end);
+  frame_member const& last = result.back();
+  if (input.tellg() != start + static_cast<std::streamoff>(last.offset +
+                                                           last.size())) {
+    throw std::runtime_error("Incorrect input");
+  }
+  input.seekg(start);
+  return result;
+}
+
+uint64_t append_members(std::istream& input, std::ostream& output) {
+  std::vector<frame_member> members = read_complete_members(input);
+  uint64_t size = members.back().offset + members.back().size();
+  std::array<char, IO_CHUNK_SIZE> chunk; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  for (uint64_t copied = 0; copied < size;) {
+    input.read(chunk.data(), static_cast<std::streamsize>(
+                                 std::min<uint64_t>(chunk.size(), size - copied)));
+    if (input.gcount() == 0) {
+      throw std::runtime_error("Incorrect input");
+    }
+    output.write(chunk.data(), input.gcount());
+    copied += static_cast<uint64_t>(input.gcount());
+  }
+  if (!output) {
+    throw std::runtime_error("cannot write output file");
+  }
+  return size;
+}
+} // namespace huffman
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "constants.h"
+#include "filter.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace huffman {
+// Framed stream consists of members (numbers are little-endian):
+// FRAME_MAGIC, version (1 byte), flags (1 byte, FRAME_FLAG_*),
+// original size (8 bytes), payload size (8 bytes), filter type and width
+// (1 byte each, if FRAME_FLAG_FILTER is set), payload (legacy stream of
+// filtered data), CRC-32C of original data (4 bytes, if FRAME_FLAG_CHECKSUM
+// is set).
+// Version 1 members have no flags byte and always have checksum.
+// Unknown version or flags are rejected
+struct frame_header {
+  uint8_t version{FRAME_VERSION};
+  uint8_t flags{FRAME_FLAG_CHECKSUM};
+  uint64_t original_size{0};
+  uint64_t payload_size{0};
+  // used only if FRAME_FLAG_FILTER is set
+  filter filter_;
+
+  bool has_flag(uint8_t flag) const;
+
+  size_t header_size() const;
+
+  size_t trailer_size() const;
+
+  // the biggest original size that payload can be decoded to, as every
+  // symbol takes at least one bit of it
+  uint64_t max_original_size() const;
+
+  // writes header of current version
+  void write(std::ostream& output) const;
+
+  // first byte of FRAME_MAGIC must be already read from input
+  // (decoder reads it to tell framed stream from legacy one)
+  static frame_header read(std::istream& input);
+
+  // data contains size bytes, starting with FRAME_MAGIC
+  static frame_header parse(uint8_t const* data, size_t size);
+};
+
+// size of header and trailer of member of current version with flags
+size_t frame_overhead(uint8_t flags);
+
+struct frame_member {
+  // offset of member from beginning of stream
+  uint64_t offset{0};
+  frame_header header;
+
+  uint64_t size() const;
+};
+
+// Reads headers of all members of framed stream, skipping their payloads.
+// Returns empty vector if stream is legacy. Throws std::runtime_error if
+// the last member is continued or stream is shorter than its members, so
+// sum of their original sizes is bounded by stream size. Input must be
+// seekable
+std::vector<frame_member> read_members(std::istream& input);
+
+// The same, but also throws std::runtime_error if stream is legacy or
+// doesn't end with its last member, so stream can be appended to
+std::vector<frame_member> read_complete_members(std::istream& input);
+
+// Appends members of framed stream in input to output, which is empty or
+// ends with complete framed stream. Only headers are read, payloads are
+// copied as they are. Returns number of copied bytes, throws
+// std::runtime_error if input isn't complete framed stream
+uint64_t append_members(std::istream& input, std::ostream& output);
+
+void write_number(std::ostream& output, uint64_t number, size_t size);
+
+uint64_t read_number(std::istream& input, size_t size);
+
+uint64_t read_number(uint8_t const* data, size_t size);
+} // namespace huffman
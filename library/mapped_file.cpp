@@ -0,0 +1,122 @@
+#include "mapped_file.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HUFFMAN_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace huffman {
+mapped_file::mapped_file(std::filesystem::path const& path) {
+#ifdef HUFFMAN_MMAP
+  int fd = open(path.c_str(), O_RDONLY); // NOLINT(cppcoreguidelines-pro-type-vararg)
+  if (fd == -1) {
+    throw std::runtime_error("cannot open input file");
+  }
+  struct stat info {};
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size),
+                         PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED) {
+      madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+      data_ = static_cast<uint8_t const*>(address);
+      size_ = static_cast<size_t>(info.st_size);
+      mapped = true;
+    }
+  }
+  close(fd);
+  if (mapped) {
+    return;
+  }
+#endif
+  std::ifstream input(path, std::ios::binary);
+  if (!input.is_open()) {
+    throw std::runtime_error("cannot open input file");
+  }
+  content.assign(std::istreambuf_iterator<char>(input),
+                 std::istreambuf_iterator<char>());
+  data_ = reinterpret_cast<uint8_t const*>(content.data());
+  size_ = content.size();
+}
+
+mapped_file::~mapped_file() {
+#ifdef HUFFMAN_MMAP
+  if (mapped) {
+    munmap(const_cast<uint8_t*>(data_), size_); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+  }
+#endif
+}
+
+uint8_t const* mapped_file::data() const {
+  return data_;
+}
+
+size_t mapped_file::size() const {
+  return size_;
+}
+
+mapped_output::mapped_output(std::filesystem::path const& path, size_t size)
+    : path_(path), size_(size) {
+#ifdef HUFFMAN_MMAP
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666); // NOLINT(cppcoreguidelines-pro-type-vararg)
+  if (fd == -1 || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    if (fd != -1) {
+      close(fd);
+    }
+    throw std::runtime_error("cannot open output file");
+  }
+  if (size > 0) {
+    void* address =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address != MAP_FAILED) {
+      madvise(address, size, MADV_SEQUENTIAL);
+      data_ = static_cast<uint8_t*>(address);
+      mapped = true;
+    }
+  }
+  close(fd);
+  if (mapped || size == 0) {
+    return;
+  }
+#endif
+  content.resize(size);
+  data_ = reinterpret_cast<uint8_t*>(content.data());
+}
+
+mapped_output::~mapped_output() {
+#ifdef HUFFMAN_MMAP
+  if (mapped) {
+    munmap(data_, size_);
+  }
+#endif
+}
+
+uint8_t* mapped_output::data() {
+  return data_;
+}
+
+size_t mapped_output::size() const {
+  return size_;
+}
+
+void mapped_output::flush() {
+#ifdef HUFFMAN_MMAP
+  if (mapped) {
+    if (msync(data_, size_, MS_ASYNC) != 0) {
+      throw std::runtime_error("cannot write output file");
+    }
+    return;
+  }
+#endif
+  std::ofstream output(path_, std::ios::binary);
+  output.write(content.data(), static_cast<std::streamsize>(content.size()));
+  if (!output) {
+    throw std::runtime_error("cannot write output file");
+  }
+}
+} // namespace huffman
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace huffman {
+// Read-only memory mapping of whole file. If file can't be mapped (or
+// platform doesn't support it), file is read to memory
+struct mapped_file {
+  // throws std::runtime_error if file can't be opened
+  explicit mapped_file(std::filesystem::path const& path);
+
+  mapped_file(mapped_file const& other) = delete;
+
+  mapped_file& operator=(mapped_file const& other) = delete;
+
+  ~mapped_file();
+
+  uint8_t const* data() const;
+
+  size_t size() const;
+
+private:
+  uint8_t const* data_{nullptr};
+  size_t size_{0};
+  bool mapped{false};
+  std::string content;
+};
+
+// Writable memory mapping of file, that is created with given size, so
+// data is written straight to page cache. If file can't be mapped, data is
+// kept in memory and written by flush
+struct mapped_output {
+  // throws std::runtime_error if file can't be created
+  mapped_output(std::filesystem::path const& path, size_t size);
+
+  mapped_output(mapped_output const& other) = delete;
+
+  mapped_output& operator=(mapped_output const& other) = delete;
+
+  ~mapped_output();
+
+  uint8_t* data();
+
+  size_t size() const;
+
+  // throws std::runtime_error if data can't be written
+  void flush();
+
+private:
+  std::filesystem::path path_;
+  uint8_t* data_{nullptr};
+  size_t size_{0};
+  bool mapped{false};
+  std::string content;
+};
+} // namespace huffman
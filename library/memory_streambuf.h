@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <streambuf>
+
+namespace huffman {
+// Read-only stream buffer over memory, lets stream based encoder and decoder
+// work on data that is already in memory without copying it
+struct memory_streambuf : std::streambuf {
+  memory_streambuf(char const* data, size_t size) {
+    // get area is never written through
+    char* begin = const_cast<char*>(data); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+    setg(begin, begin, begin + size);
+  }
+};
+} // namespace huffman
@@ -0,0 +1,162 @@
+#include "messages.h"
+#include "crc32c.h"
+#include "decoder.h"
+#include "frame.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace huffman {
+namespace {
+// cache is cleared when it has more trees, so it can't grow unbounded on
+// messages with different headers
+constexpr size_t MAX_CACHED_TREES = 1024;
+
+message_result decode_one(message_decoder& decoder_, message const& message_) {
+  message_result result;
+  try {
+    result.output_size = decoder_.decode(message_);
+  } catch (std::exception const& e) {
+    result.error = e.what();
+  }
+  return result;
+}
+} // namespace
+
+size_t message_decoder::decode(message const& message_) {
+  uint8_t const* data = message_.input;
+  size_t size = message_.input_size;
+  if (size == 0) {
+    throw std::runtime_error("Incorrect input");
+  }
+  size_t output_size = 0;
+  if (data[0] != FRAME_MAGIC[0] || size == 1) {
+    output_size = decode_payload(data, size, message_);
+  } else {
+    frame_header header = frame_header::parse(data, size);
+    size_t overhead = header.header_size() + header.trailer_size();
+    if (header.has_flag(FRAME_FLAG_CONTINUED) || size < overhead ||
+        header.payload_size != size - overhead) {
+      throw std::runtime_error("Incorrect input");
+    }
+    if (header.original_size > message_.output_capacity) {
+      throw std::runtime_error("Output is too small");
+    }
+    output_size =
+        header.has_flag(FRAME_FLAG_FILTER)
+            ? decode_filtered(data + header.header_size(), header, message_)
+            : decode_payload(data + header.header_size(),
+                             header.payload_size, message_);
+    if (output_size != header.original_size) {
+      throw std::runtime_error("Incorrect input");
+    }
+    if (header.has_flag(FRAME_FLAG_CHECKSUM)) {
+      crc32c checksum;
+      checksum.update(message_.output, output_size);
+      if (read_number(data + size - FRAME_TRAILER_SIZE, FRAME_TRAILER_SIZE) !=
+          checksum.value()) {
+        throw std::runtime_error("Checksum mismatch");
+      }
+    }
+  }
+  return output_size;
+}
+
+std::vector<message_result>
+message_decoder::decode(std::vector<message> const& messages) {
+  std::vector<message_result> result;
+  result.reserve(messages.size());
+  for (message const& message_ : messages) {
+    result.push_back(decode_one(*this, message_));
+  }
+  return result;
+}
+
+size_t message_decoder::cached_trees() const {
+  return cached_trees_count;
+}
+
+size_t message_decoder::decode_payload(uint8_t const* data, size_t size,
+                                       message const& message_) {
+  if (data[0] == 0) {
+    // empty stream consists of one zero byte
+    if (size != 1) {
+      throw std::runtime_error("Incorrect input");
+    }
+    return 0;
+  }
+  if (decoder::get_header_size(data[0]) > size) {
+    throw std::runtime_error("Incorrect input");
+  }
+  return get_codec(data).decode(data, size, buffer, message_.output,
+                                message_.output_capacity);
+}
+
+size_t message_decoder::decode_filtered(uint8_t const* data,
+                                        frame_header const& header,
+                                        message const& message_) {
+  // every char takes at least one bit
+  filtered.resize(
+      std::min<size_t>(header.filter_.max_filtered_size(header.original_size),
+                       header.payload_size * BYTE_SIZE));
+  message filtered_message{data, header.payload_size,
+                           reinterpret_cast<uint8_t*>(filtered.data()),
+                           filtered.size()};
+  size_t filtered_size = 0;
+  try {
+    filtered_size = decode_payload(data, header.payload_size, filtered_message);
+  } catch (std::runtime_error const&) {
+    // filtered data doesn't fit only if it is incorrect
+    throw std::runtime_error("Incorrect input");
+  }
+  auto filtered_data = reinterpret_cast<uint8_t const*>(filtered.data());
+  return header.filter_.revert(filtered_data, filtered_size, message_.output,
+                               header.original_size);
+}
+
+codec const& message_decoder::get_codec(uint8_t const* header) {
+  std::string_view key = table_cache::get_key(header, key_buffer);
+  uint64_t hash = std::hash<std::string_view>()(key);
+  auto it = cache.find(hash);
+  if (it != cache.end()) {
+    for (cache_entry const& entry : it->second) {
+      if (entry.key == key) {
+        return *entry.codec_;
+      }
+    }
+  }
+
+  // local cache needs no locks, shared one is used only on its misses
+  std::shared_ptr<codec const> result = table_cache::global().get(header);
+  if (cached_trees_count >= MAX_CACHED_TREES) {
+    cache.clear();
+    cached_trees_count = 0;
+  }
+  cache[hash].push_back({std::string(key), result});
+  ++cached_trees_count;
+  return *result;
+}
+
+std::vector<message_result> decode_messages(std::vector<message> const& messages,
+                                            size_t threads_count) {
+  threads_count = std::min(threads_count, messages.size());
+  if (threads_count <= 1) {
+    return message_decoder().decode(messages);
+  }
+  std::vector<message_result> results(messages.size());
+  size_t range_size = (messages.size() + threads_count - 1) / threads_count;
+  thread_pool pool(threads_count);
+  for (size_t begin = 0; begin < messages.size(); begin += range_size) {
+    size_t end = std::min(begin + range_size, messages.size());
+    pool.submit([&messages, &results, begin, end] {
+      message_decoder decoder_;
+      for (size_t i = begin; i < end; ++i) {
+        results[i] = decode_one(decoder_, messages[i]);
+      }
+    });
+  }
+  pool.wait();
+  return results;
+}
+} // namespace huffman
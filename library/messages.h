@@ -0,0 +1,75 @@
+#pragma once
+
+#include "bit_sequence.h"
+#include "codec.h"
+#include "table_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace huffman {
+struct frame_header;
+
+// Encoded message in memory and place for its decoded data
+struct message {
+  uint8_t const* input{nullptr};
+  size_t input_size{0};
+  uint8_t* output{nullptr};
+  size_t output_capacity{0};
+};
+
+struct message_result {
+  size_t output_size{0};
+  // empty if message was decoded successfully
+  std::string error;
+};
+
+// Decodes many small independent messages, legacy or framed with one member.
+// Scratch memory is shared by all messages, codecs of messages with
+// identical headers are built once and cached by hash of header
+struct message_decoder {
+  message_decoder() = default;
+
+  message_decoder(message_decoder const& other) = delete;
+
+  message_decoder& operator=(message_decoder const& other) = delete;
+
+  ~message_decoder() = default;
+
+  // throws std::runtime_error if message is incorrect or output doesn't fit
+  size_t decode(message const& message_);
+
+  std::vector<message_result> decode(std::vector<message> const& messages);
+
+  size_t cached_trees() const;
+
+private:
+  struct cache_entry {
+    // header bytes, that contain traversal, unused bits are zero
+    std::string key;
+    std::shared_ptr<codec const> codec_;
+  };
+
+  size_t decode_payload(uint8_t const* data, size_t size,
+                        message const& message_);
+  size_t decode_filtered(uint8_t const* data, frame_header const& header,
+                         message const& message_);
+  codec const& get_codec(uint8_t const* header);
+
+  std::unordered_map<uint64_t, std::vector<cache_entry>> cache;
+  size_t cached_trees_count{0};
+  table_cache::key_buffer key_buffer;
+  bit_sequence buffer;
+  // decoded data of filtered messages
+  std::string filtered;
+};
+
+// Messages are split to ranges decoded on threads_count threads, every
+// thread has its own message_decoder
+std::vector<message_result> decode_messages(std::vector<message> const& messages,
+                                            size_t threads_count);
+} // namespace huffman
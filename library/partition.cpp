@@ -0,0 +1,63 @@
+#include "partition.h"
+#include "encoder.h"
+#include "frame.h"
+#include "memory_streambuf.h"
+#include <algorithm>
+#include <istream>
+
+namespace huffman {
+namespace {
+size_t framed_size(std::array<size_t, CHARS_COUNT> const& counts) {
+  return encoder::get_output_size(counts) + frame_overhead(FRAME_FLAG_CHECKSUM);
+}
+} // namespace
+
+std::vector<block> partition(uint8_t const* data, size_t size,
+                             size_t granule_size) {
+  granule_size = std::max<size_t>(granule_size, 1);
+  std::vector<block> result;
+  block granule;
+  for (size_t offset = 0; offset < size || result.empty();
+       offset += granule_size) {
+    granule.offset = offset;
+    granule.size = std::min(granule_size, size - offset);
+    granule.counts.fill(0);
+    for (size_t i = offset; i < offset + granule.size; ++i) {
+      ++granule.counts[data[i]];
+    }
+    granule.encoded_size = framed_size(granule.counts);
+    if (result.empty()) {
+      result.push_back(granule);
+      continue;
+    }
+    block& last = result.back();
+    std::array<size_t, CHARS_COUNT> merged = last.counts;
+    for (size_t i = 0; i < CHARS_COUNT; ++i) {
+      merged[i] += granule.counts[i];
+    }
+    size_t merged_size = framed_size(merged);
+    if (merged_size <= last.encoded_size + granule.encoded_size) {
+      last.size += granule.size;
+      last.counts = merged;
+      last.encoded_size = merged_size;
+    } else {
+      result.push_back(granule);
+    }
+  }
+  return result;
+}
+
+void encode_blocks(uint8_t const* data, std::vector<block> const& blocks,
+                   std::ostream& output, uint8_t flags) {
+  for (block const& block_ : blocks) {
+    bool last = &block_ == &blocks.back();
+    encoder encoder_;
+    encoder_.add_chars(data + block_.offset, block_.size);
+    memory_streambuf buffer(reinterpret_cast<char const*>(data) + block_.offset,
+                            block_.size);
+    std::istream input(&buffer);
+    encoder_.encode_framed(input, output,
+                           last ? flags : flags | FRAME_FLAG_CONTINUED);
+  }
+}
+} // namespace huffman
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "constants.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace huffman {
+struct block {
+  size_t offset{0};
+  size_t size{0};
+  std::array<size_t, CHARS_COUNT> counts{};
+  // size of block as member of framed stream
+  size_t encoded_size{0};
+};
+
+// Splits data to blocks of whole granules, so that every block gets its own
+// table only where it pays off: next granule is appended to current block if
+// exact encoded size of them with one table is not bigger than with two
+std::vector<block> partition(uint8_t const* data, size_t size,
+                             size_t granule_size = PARTITION_GRANULE_SIZE);
+
+// writes every block as member of one framed stream, see frame.h.
+// flags are FRAME_FLAG_* of every member, all members except the last are
+// marked as continued
+void encode_blocks(uint8_t const* data, std::vector<block> const& blocks,
+                   std::ostream& output, uint8_t flags = FRAME_FLAG_CHECKSUM);
+} // namespace huffman
@@ -0,0 +1,134 @@
+#include "sampling.h"
+#include "crc32c.h"
+#include "encoder.h"
+#include "frame.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace huffman {
+std::array<size_t, CHARS_COUNT> sample_counts(uint8_t const* data, size_t size,
+                                              size_t sample_size) {
+  std::array<size_t, CHARS_COUNT> result{};
+  if (size <= sample_size) {
+    for (size_t i = 0; i < size; ++i) {
+      ++result[data[i]];
+    }
+    return result;
+  }
+  size_t chunk_size = std::clamp<size_t>(sample_size, 1, SAMPLE_CHUNK_SIZE);
+  size_t chunks_count = std::max<size_t>(sample_size / chunk_size, 1);
+  // chunks are at the start of equal parts of data
+  size_t step = size / chunks_count;
+  for (size_t i = 0; i < chunks_count; ++i) {
+    uint8_t const* chunk = data + i * step;
+    for (size_t j = 0; j < chunk_size; ++j) {
+      ++result[chunk[j]];
+    }
+  }
+  double scale = static_cast<double>(size) /
+                 static_cast<double>(chunk_size * chunks_count);
+  for (size_t& count : result) {
+    if (count != 0) {
+      count = std::max<size_t>(
+          static_cast<size_t>(static_cast<double>(count) * scale), 1);
+    }
+  }
+  return result;
+}
+
+namespace {
+// Writes legacy stream or framed member of data to seekable output with
+// codes of encoder. Header of member is written with zero payload size,
+// which is patched after payload. Returns size of written stream
+size_t write_stream(uint8_t const* data, size_t size, encoder& encoder_,
+                    std::ostream& output, bool legacy, uint8_t flags) {
+  crc32c checksum;
+  bool use_checksum = !legacy && (flags & FRAME_FLAG_CHECKSUM) != 0;
+  std::ostream::pos_type start = output.tellp();
+  frame_header header_;
+  if (!legacy) {
+    header_.flags = flags;
+    header_.original_size = size;
+    header_.write(output);
+  }
+  if (!encoder_.encode_estimated(data, size, output,
+                                 use_checksum ? &checksum : nullptr)) {
+    throw std::runtime_error("Counts don't match data");
+  }
+  if (legacy) {
+    return encoder_.get_output_size();
+  }
+  header_.payload_size = encoder_.get_output_size();
+  std::ostream::pos_type end = output.tellp();
+  output.seekp(start);
+  header_.write(output);
+  output.seekp(end);
+  if (use_checksum) {
+    write_number(output, checksum.value(), FRAME_TRAILER_SIZE);
+  }
+  return header_.payload_size + frame_overhead(flags);
+}
+} // namespace
+
+sampled_result encode_sampled(uint8_t const* data, size_t size,
+                              std::array<size_t, CHARS_COUNT> const& counts,
+                              std::ostream& output, bool legacy,
+                              uint8_t flags, size_t sample_size) {
+  sampled_result result;
+  // sample can miss rare chars of data, they get escape codes
+  std::array<size_t, CHARS_COUNT> estimated = counts;
+  if (size > sample_size) {
+    for (size_t& count : estimated) {
+      count = std::max<size_t>(count, 1);
+    }
+  }
+  std::array<size_t, CHARS_COUNT> exact{};
+  auto add_exact = [&](encoder const& encoder_) {
+    for (size_t ch = 0; ch < CHARS_COUNT; ++ch) {
+      exact[ch] += encoder_.get_counts()[ch];
+    }
+  };
+  if (output.tellp() != std::ostream::pos_type(-1)) {
+    encoder encoder_;
+    encoder_.add_counts(estimated);
+    result.output_size =
+        write_stream(data, size, encoder_, output, legacy, flags);
+    add_exact(encoder_);
+    result.exact_output_size =
+        encoder::get_output_size(exact) +
+        (legacy ? 0 : frame_overhead(flags));
+  } else {
+    // output can't be patched, so data is written by framed members, which
+    // are encoded to memory one at a time
+    std::stringstream member;
+    size_t offset = 0;
+    do {
+      size_t member_size = std::min(SAMPLED_MEMBER_SIZE, size - offset);
+      bool last = offset + member_size == size;
+      uint8_t member_flags =
+          last ? flags : static_cast<uint8_t>(flags | FRAME_FLAG_CONTINUED);
+      encoder encoder_;
+      encoder_.add_counts(estimated);
+      member.str(std::string());
+      result.output_size += write_stream(data + offset, member_size,
+                                         encoder_, member, false,
+                                         member_flags);
+      output << member.rdbuf();
+      ++result.members_count;
+      add_exact(encoder_);
+      result.exact_output_size +=
+          encoder::get_output_size(encoder_.get_counts()) +
+          frame_overhead(member_flags);
+      offset += member_size;
+    } while (offset < size);
+  }
+  for (size_t ch = 0; ch < CHARS_COUNT; ++ch) {
+    if (counts[ch] == 0 && exact[ch] != 0) {
+      ++result.missed_chars;
+    }
+  }
+  return result;
+}
+} // namespace huffman
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "constants.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace huffman {
+// Counts of chars in about sample_size bytes of data, read by chunks at
+// equal distances, scaled to size. Data not bigger than sample_size is
+// counted exactly
+std::array<size_t, CHARS_COUNT> sample_counts(uint8_t const* data, size_t size,
+                                              size_t sample_size = SAMPLE_SIZE);
+
+struct sampled_result {
+  // size of written stream
+  size_t output_size{0};
+  // size of stream with codes of exact counts
+  size_t exact_output_size{0};
+  // chars of data missed by sample, they are written by escape codes
+  size_t missed_chars{0};
+  // number of framed members written instead of one stream, because output
+  // isn't seekable, zero otherwise
+  size_t members_count{0};
+};
+
+// Writes data as legacy stream or as framed member with FRAME_FLAG_* flags,
+// with codes of counts estimated by sample_counts with sample_size, see
+// encoder::encode_estimated. If data is bigger than sample, every char
+// missed by sample gets a long escape code of count 1, so data is read once.
+// Header of stream is patched after payload, so output should be seekable.
+// Otherwise data is written by framed members of SAMPLED_MEMBER_SIZE bytes,
+// each of them is encoded to memory first. Throws if counts don't match data
+sampled_result encode_sampled(uint8_t const* data, size_t size,
+                              std::array<size_t, CHARS_COUNT> const& counts,
+                              std::ostream& output, bool legacy,
+                              uint8_t flags = FRAME_FLAG_CHECKSUM,
+                              size_t sample_size = SAMPLE_SIZE);
+} // namespace huffman
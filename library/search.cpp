@@ -0,0 +1,71 @@
+#include "search.h"
+#include "decoder.h"
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+namespace huffman {
+search_streambuf::search_streambuf(std::string pattern_,
+                                   std::function<void(size_t)> on_match)
+    : pattern(std::move(pattern_)),
+      searcher(pattern.begin(), pattern.end()),
+      on_match(std::move(on_match)) {
+  if (pattern.empty()) {
+    throw std::runtime_error("Pattern is empty");
+  }
+}
+
+std::streamsize search_streambuf::xsputn(char const* data,
+                                         std::streamsize size) {
+  auto count = static_cast<size_t>(size);
+  size_t keep = pattern.size() - 1;
+  // matches, that start in tail, are found in tail with start of data
+  size_t tail_size = tail.size();
+  tail.append(data, std::min(count, keep));
+  if (tail_size != 0) {
+    scan(tail.data(), tail.size(), tail_size, written - tail_size);
+  }
+  scan(data, count, count, written);
+  written += count;
+  // tail keeps last pattern.size() - 1 bytes of written data
+  if (count >= keep) {
+    tail.assign(data + count - keep, keep);
+  } else if (tail.size() > keep) {
+    tail.erase(0, tail.size() - keep);
+  }
+  return size;
+}
+
+search_streambuf::int_type search_streambuf::overflow(int_type ch) {
+  if (traits_type::eq_int_type(ch, traits_type::eof())) {
+    return traits_type::not_eof(ch);
+  }
+  char byte = traits_type::to_char_type(ch);
+  xsputn(&byte, 1);
+  return ch;
+}
+
+void search_streambuf::scan(char const* data, size_t size, size_t end,
+                            size_t offset) {
+  char const* last = data + size;
+  char const* it = data;
+  while ((it = std::search(it, last, searcher)) != last &&
+         it < data + end) {
+    on_match(offset + (it - data));
+    ++it;
+  }
+}
+
+size_t search(std::istream& input, std::string const& pattern,
+              std::function<void(size_t)> const& on_match) {
+  size_t count = 0;
+  search_streambuf buffer(pattern, [&](size_t offset) {
+    ++count;
+    on_match(offset);
+  });
+  std::ostream output(&buffer);
+  decoder().decode(input, output);
+  return count;
+}
+} // namespace huffman
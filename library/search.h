@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <streambuf>
+#include <string>
+
+namespace huffman {
+// Stream buffer, that finds all occurrences of pattern, overlapping ones
+// too, in data written to it. Data isn't kept, only last pattern size - 1
+// bytes, so matches can cross writes. on_match is called with offset of
+// every match in written data
+struct search_streambuf : std::streambuf {
+  // throws std::runtime_error if pattern is empty
+  search_streambuf(std::string pattern, std::function<void(size_t)> on_match);
+
+  search_streambuf(search_streambuf const& other) = delete;
+
+  search_streambuf& operator=(search_streambuf const& other) = delete;
+
+  ~search_streambuf() override = default;
+
+protected:
+  std::streamsize xsputn(char const* data, std::streamsize size) override;
+
+  int_type overflow(int_type ch) override;
+
+private:
+  // reports matches, that start in data before end
+  void scan(char const* data, size_t size, size_t end, size_t offset);
+
+  std::string pattern;
+  std::boyer_moore_horspool_searcher<std::string::const_iterator> searcher;
+  std::function<void(size_t)> on_match;
+  std::string tail;
+  size_t written{0};
+};
+
+// Decodes stream of any format straight to search_streambuf, so decoded
+// data is never stored. Returns number of matches, throws
+// std::runtime_error if input is incorrect
+size_t search(std::istream& input, std::string const& pattern,
+              std::function<void(size_t)> const& on_match);
+} // namespace huffman
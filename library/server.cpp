@@ -0,0 +1,326 @@
+#include "server.h"
+#include "constants.h"
+#include "frame.h"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HUFFMAN_SOCKETS
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace huffman {
+namespace {
+constexpr size_t SIZE_SIZE = 4;
+constexpr size_t NUMBER_SIZE = 8;
+
+// count of items read from rest of body, which are at least item_size
+// bytes each, so it isn't trusted before allocation
+size_t read_count(std::istream& input, size_t body_size, size_t item_size) {
+  size_t count = read_number(input, SIZE_SIZE);
+  auto position = static_cast<size_t>(input.tellg());
+  if (count > (body_size - position) / item_size) {
+    throw std::runtime_error("Incorrect input");
+  }
+  return count;
+}
+
+void write_string(std::ostream& output, std::string const& value) {
+  write_number(output, value.size(), SIZE_SIZE);
+  output.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+std::string read_string(std::istream& input) {
+  std::string result(read_number(input, SIZE_SIZE), '\0');
+  input.read(result.data(), static_cast<std::streamsize>(result.size()));
+  if (input.fail()) {
+    throw std::runtime_error("Incorrect input");
+  }
+  return result;
+}
+
+#ifdef HUFFMAN_SOCKETS
+// closes descriptor when leaves scope
+struct descriptor {
+  explicit descriptor(int fd) : fd(fd) {}
+
+  descriptor(descriptor const& other) = delete;
+
+  descriptor& operator=(descriptor const& other) = delete;
+
+  ~descriptor() {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+
+  int fd;
+};
+
+sockaddr_un get_address(std::filesystem::path const& path) {
+  sockaddr_un result{};
+  result.sun_family = AF_UNIX;
+  std::string name = path.string();
+  if (name.size() >= sizeof(result.sun_path)) {
+    throw std::runtime_error("Socket path is too long");
+  }
+  std::memcpy(result.sun_path, name.c_str(), name.size() + 1);
+  return result;
+}
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+// peer, that disconnects before response, gives error instead of SIGPIPE,
+// so signal handling of process isn't changed
+void prepare_socket(int fd, size_t receive_timeout_ms) {
+#ifdef SO_NOSIGPIPE
+  int enabled = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+  auto set_timeout = [fd](int option, size_t timeout_ms) {
+    timeval timeout{};
+    timeout.tv_sec = static_cast<time_t>(timeout_ms / 1000);
+    timeout.tv_usec = static_cast<suseconds_t>(timeout_ms % 1000 * 1000);
+    setsockopt(fd, SOL_SOCKET, option, &timeout, sizeof(timeout));
+  };
+  set_timeout(SO_RCVTIMEO, receive_timeout_ms);
+  set_timeout(SO_SNDTIMEO, CONNECTION_TIMEOUT_MS);
+}
+
+void write_all(int fd, std::string const& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t count = send(fd, data.data() + written, data.size() - written,
+                         SEND_FLAGS);
+    if (count == -1 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      throw std::runtime_error("Connection is closed");
+    }
+    written += count;
+  }
+}
+
+std::string read_exactly(int fd, size_t size) {
+  std::string result(size, '\0');
+  size_t done = 0;
+  while (done < size) {
+    ssize_t count = read(fd, result.data() + done, size - done);
+    if (count == -1 && errno == EINTR) {
+      continue;
+    }
+    if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      throw std::runtime_error("Connection timed out");
+    }
+    if (count <= 0) {
+      throw std::runtime_error("Connection is closed");
+    }
+    done += count;
+  }
+  return result;
+}
+
+// message is body with its size
+void write_message(int fd, std::string const& body) {
+  std::ostringstream output;
+  write_string(output, body);
+  write_all(fd, output.str());
+}
+
+std::string read_message(int fd) {
+  std::string size = read_exactly(fd, SIZE_SIZE);
+  size_t body_size =
+      read_number(reinterpret_cast<uint8_t const*>(size.data()), SIZE_SIZE);
+  if (body_size > MAX_MESSAGE_SIZE) {
+    throw std::runtime_error("Incorrect input");
+  }
+  return read_exactly(fd, body_size);
+}
+
+std::string transfer(std::filesystem::path const& path,
+                     std::string const& body) {
+  descriptor connection(socket(AF_UNIX, SOCK_STREAM, 0));
+  if (connection.fd == -1) {
+    throw std::runtime_error("cannot create socket");
+  }
+  prepare_socket(connection.fd, RESPONSE_TIMEOUT_MS);
+  sockaddr_un address = get_address(path);
+  if (connect(connection.fd, reinterpret_cast<sockaddr const*>(&address),
+              sizeof(address)) == -1) {
+    throw std::runtime_error("cannot connect to server");
+  }
+  write_message(connection.fd, body);
+  return read_message(connection.fd);
+}
+#endif
+
+std::string write_request(uint8_t type, request const& request_) {
+  std::ostringstream output;
+  output.put(static_cast<char>(type));
+  output.put(static_cast<char>(request_.checksum));
+  write_number(output, request_.files.size(), SIZE_SIZE);
+  for (file_pair const& files : request_.files) {
+    write_string(output, files.first.string());
+    write_string(output, files.second.string());
+  }
+  return output.str();
+}
+
+std::string write_response(std::vector<batch_result> const& results) {
+  std::ostringstream output;
+  write_number(output, results.size(), SIZE_SIZE);
+  for (batch_result const& result : results) {
+    write_number(output, result.input_size, NUMBER_SIZE);
+    write_number(output, result.output_size, NUMBER_SIZE);
+    write_string(output, result.error);
+  }
+  return output.str();
+}
+
+std::vector<batch_result> read_response(std::string const& body) {
+  std::istringstream input(body);
+  std::vector<batch_result> result(
+      read_count(input, body.size(), 2 * NUMBER_SIZE + SIZE_SIZE));
+  for (batch_result& file_result : result) {
+    file_result.input_size = read_number(input, NUMBER_SIZE);
+    file_result.output_size = read_number(input, NUMBER_SIZE);
+    file_result.error = read_string(input);
+  }
+  return result;
+}
+} // namespace
+
+#ifdef HUFFMAN_SOCKETS
+server::server(std::filesystem::path path, batch_options const& options)
+    : path(std::move(path)), options(options), pool(options.threads) {
+  sockaddr_un address = get_address(this->path);
+  if (std::filesystem::is_socket(this->path)) {
+    std::filesystem::remove(this->path);
+  }
+  socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd == -1) {
+    throw std::runtime_error("cannot create socket");
+  }
+  if (bind(socket_fd, reinterpret_cast<sockaddr const*>(&address),
+           sizeof(address)) == -1 ||
+      listen(socket_fd, SOMAXCONN) == -1) {
+    close(socket_fd);
+    throw std::runtime_error("cannot create socket");
+  }
+}
+
+server::~server() {
+  stop();
+}
+
+void server::stop() {
+  if (socket_fd == -1) {
+    return;
+  }
+  close(socket_fd);
+  socket_fd = -1;
+  std::error_code ignored;
+  std::filesystem::remove(path, ignored);
+}
+
+void server::run() {
+  // connections are served one at a time, the next ones wait in backlog of
+  // socket, because requests share the pool and wait for all its tasks
+  while (true) {
+    descriptor connection(accept(socket_fd, nullptr, nullptr));
+    if (connection.fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      throw std::runtime_error("cannot accept connection");
+    }
+    // idle client is dropped by timeout, so it doesn't block next ones
+    prepare_socket(connection.fd, CONNECTION_TIMEOUT_MS);
+    try {
+      if (!handle(connection.fd)) {
+        // new clients fail to connect instead of waiting
+        stop();
+        return;
+      }
+    } catch (std::exception const&) {
+      // incorrect request only closes its connection
+    }
+  }
+}
+
+bool server::handle(int connection) {
+  std::string body = read_message(connection);
+  std::istringstream input(body);
+  uint8_t type = input.get();
+  if (type == REQUEST_STOP) {
+    write_message(connection, write_response({}));
+    return false;
+  }
+  if (type != REQUEST_COMPRESS && type != REQUEST_DECOMPRESS) {
+    throw std::runtime_error("Incorrect input");
+  }
+  batch_options request_options = options;
+  request_options.checksum = input.get() != 0;
+  // every pair has sizes of both paths
+  std::vector<file_pair> files(read_count(input, body.size(), 2 * SIZE_SIZE));
+  for (file_pair& pair : files) {
+    pair.first = read_string(input);
+    pair.second = read_string(input);
+  }
+  std::vector<batch_result> results =
+      type == REQUEST_COMPRESS
+          ? compress_files(files, request_options, pool)
+          : decompress_files(files, request_options, pool);
+  write_message(connection, write_response(results));
+  return true;
+}
+
+std::vector<batch_result> send_request(std::filesystem::path const& path,
+                                       request const& request_) {
+  return read_response(transfer(
+      path, write_request(request_.compress ? REQUEST_COMPRESS
+                                            : REQUEST_DECOMPRESS,
+                          request_)));
+}
+
+void stop_server(std::filesystem::path const& path) {
+  transfer(path, write_request(REQUEST_STOP, request()));
+}
+#else
+server::server(std::filesystem::path path, batch_options const& options)
+    : path(std::move(path)), options(options), pool(1) {
+  throw std::runtime_error("UNIX domain sockets are not supported");
+}
+
+server::~server() = default;
+
+void server::run() {}
+
+void server::stop() {}
+
+bool server::handle(int) {
+  return false;
+}
+
+std::vector<batch_result> send_request(std::filesystem::path const&,
+                                       request const&) {
+  throw std::runtime_error("UNIX domain sockets are not supported");
+}
+
+void stop_server(std::filesystem::path const&) {
+  throw std::runtime_error("UNIX domain sockets are not supported");
+}
+#endif
+} // namespace huffman
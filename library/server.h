@@ -0,0 +1,64 @@
+#pragma once
+
+#include "batch.h"
+#include "thread_pool.h"
+#include <filesystem>
+#include <vector>
+
+namespace huffman {
+// Files are compressed to framed streams with or without checksum, or
+// decompressed. Paths are used by server as they are, so they should be
+// absolute
+struct request {
+  bool compress{true};
+  bool checksum{true};
+  std::vector<file_pair> files;
+};
+
+// Long-running compression server on UNIX domain socket. Every connection
+// carries one request and its response (numbers are little-endian):
+// - request: 4 bytes of body size, body: 1 byte of REQUEST_* type,
+//   1 byte checksum flag, 4 bytes of files count, then for each pair input
+//   and output path, each as 4 bytes of size and bytes
+// - response: 4 bytes of body size, body: 4 bytes of results count, then for
+//   each result 8 bytes of input size, 8 bytes of output size and error as
+//   4 bytes of size and bytes
+// Thread pool and decoding trees of table_cache::global() are kept between
+// requests, so requests don't pay for their construction. Server is serial:
+// one request is processed at a time, others wait for it
+struct server {
+  // listens on socket at path, replacing existing socket file. Throws
+  // std::runtime_error if socket can't be created
+  server(std::filesystem::path path, batch_options const& options);
+
+  server(server const& other) = delete;
+
+  server& operator=(server const& other) = delete;
+
+  // closes socket and removes its file
+  ~server();
+
+  // serves requests one by one until stop request. Files of a request are
+  // processed in parallel, as in batch mode
+  void run();
+
+private:
+  // returns false for stop request
+  bool handle(int connection);
+  // closes socket and removes its file
+  void stop();
+
+  std::filesystem::path path;
+  batch_options options;
+  thread_pool pool;
+  int socket_fd{-1};
+};
+
+// Returns result for every file of request, throws std::runtime_error if
+// server doesn't respond
+std::vector<batch_result> send_request(std::filesystem::path const& path,
+                                       request const& request_);
+
+// returns when server accepted stop request, it doesn't accept other ones
+void stop_server(std::filesystem::path const& path);
+} // namespace huffman
@@ -0,0 +1,229 @@
+#include "speculative.h"
+#include "bit_sequence.h"
+#include "codec.h"
+#include "decoder.h"
+#include "frame.h"
+#include "table_cache.h"
+#include "thread_pool.h"
+#include "tree.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace huffman {
+namespace {
+constexpr size_t NO_POSITION = std::numeric_limits<size_t>::max();
+
+// code starts at position (bit of stream) after chars decoded chars
+struct boundary {
+  size_t position;
+  size_t chars;
+};
+
+struct chunk_result {
+  std::string output;
+  // code boundaries in first SYNC_WINDOW_SIZE bits, sorted
+  std::vector<boundary> boundaries;
+  // first code boundary at or after end of chunk, NO_POSITION if stream
+  // ended before it
+  size_t end{NO_POSITION};
+  // where decoding met sync boundary, if it did
+  boundary synced{NO_POSITION, 0};
+};
+
+// bits [from, to) of data
+bit_sequence read_chunk(uint8_t const* data, size_t from, size_t to) {
+  bit_sequence result;
+  result.reserve(to - from);
+  size_t head = std::min((BYTE_SIZE - from % BYTE_SIZE) % BYTE_SIZE, to - from);
+  result.append(decoder::read_bits(data, from, head), head);
+  size_t idx = from + head;
+  for (; idx + WORD_SIZE <= to; idx += WORD_SIZE) {
+    uint64_t word; // NOLINT(cppcoreguidelines-init-variables)
+    std::memcpy(&word, data + idx / BYTE_SIZE, sizeof(word));
+    result.append(word, WORD_SIZE);
+  }
+  result.append(decoder::read_bits(data, idx, to - idx), to - idx);
+  return result;
+}
+
+boundary const* find(std::vector<boundary> const& boundaries,
+                     size_t position) {
+  auto it = std::lower_bound(
+      boundaries.begin(), boundaries.end(), position,
+      [](boundary const& a, size_t b) { return a.position < b; });
+  return it != boundaries.end() && it->position == position ? &*it : nullptr;
+}
+
+// Decodes bits [from, limit) as if code starts at from, until first code
+// boundary at or after to. Code boundaries in the first SYNC_WINDOW_SIZE
+// bits are remembered, or, if sync is given, decoding stops at the first
+// of them that is in sync
+chunk_result decode_chunk(tree const& tree_, uint8_t const* data, size_t from,
+                          size_t to, size_t limit,
+                          std::vector<boundary> const* sync) {
+  chunk_result result;
+  bit_sequence bits = read_chunk(data, from, limit);
+  size_t window = std::min(SYNC_WINDOW_SIZE, to - from);
+  size_t idx = 0;
+  uint8_t ch; // NOLINT(cppcoreguidelines-init-variables)
+  while (idx < window) {
+    if (sync == nullptr) {
+      result.boundaries.push_back({from + idx, result.output.size()});
+    } else if (boundary const* found = find(*sync, from + idx)) {
+      result.synced = *found;
+      return result;
+    }
+    if (!tree_.get_char(bits, idx, ch)) {
+      return result;
+    }
+    result.output.push_back(static_cast<char>(ch));
+  }
+  if (idx < to - from) {
+    bits.erase_front(idx);
+    size_t last = tree_.dump(bits, to - from - idx, result.output).first;
+    // dump stops before code, that isn't finished at to - from
+    while (last < to - from - idx) {
+      if (!tree_.get_char(bits, last, ch)) {
+        return result;
+      }
+      result.output.push_back(static_cast<char>(ch));
+    }
+    idx += last;
+  }
+  result.end = from + idx;
+  return result;
+}
+} // namespace
+
+std::pair<size_t, size_t> decode_speculative(uint8_t const* data, size_t size,
+                                             std::ostream& output,
+                                             size_t threads_count,
+                                             size_t chunk_size,
+                                             stats* stats_) {
+  if (size == 0 || (data[0] == FRAME_MAGIC[0] && size > 1) ||
+      decoder::get_header_size(data[0]) > size) {
+    throw std::runtime_error("Incorrect input");
+  }
+  // timers refer to local counters, which are added to stats_ at the end
+  bool collect_stats = stats_ != nullptr;
+  stats counters;
+  auto add_stats = [&](size_t output_size) {
+    if (collect_stats) {
+      stats_->input_bytes += size;
+      stats_->output_bytes += output_size;
+      stats_->symbols += output_size;
+      stats_->header_time += counters.header_time;
+      stats_->coding_time += counters.coding_time;
+      stats_->io_time += counters.io_time;
+    }
+  };
+  if (data[0] == 0) {
+    add_stats(0);
+    return {size, 0};
+  }
+  std::shared_ptr<codec const> codec_;
+  {
+    stats_timer timer(collect_stats, counters.header_time);
+    codec_ = table_cache::global().get(data);
+  }
+  tree const& tree_ = codec_->get_tree();
+  size_t traversal_end =
+      BYTE_SIZE + (data[0] * 2 + 1) * LOG_MAX_NODE_NUMBER;
+  size_t end_padding = decoder::read_bits(data, traversal_end, 3);
+  size_t start = traversal_end + 3;
+  if (size * BYTE_SIZE < start + end_padding) {
+    throw std::runtime_error("Incorrect input");
+  }
+  size_t end = size * BYTE_SIZE - end_padding;
+
+  // chunk i is [chunk_start(i), chunk_start(i + 1)), chunks start at
+  // multiples of chunk_bits, except the first one, that starts with the
+  // first code. Exact decoding of previous chunk ends in sync window
+  size_t chunk_bits = std::max(chunk_size * BYTE_SIZE, SYNC_WINDOW_SIZE);
+  size_t chunks_count =
+      end > start ? (end - 1) / chunk_bits - start / chunk_bits + 1 : 0;
+  auto chunk_start = [&](size_t i) {
+    return i == 0 ? start
+                  : std::min(end, (start / chunk_bits + i) * chunk_bits);
+  };
+  // codes are not longer than CHARS_COUNT bits, so code started in chunk
+  // ends in that number of bits after it
+  auto chunk_limit = [&](size_t i) {
+    return std::min(end, chunk_start(i + 1) + CHARS_COUNT);
+  };
+
+  // results of a round are kept until they are stitched, so memory is
+  // bounded by several chunks per thread
+  size_t round_size = std::max<size_t>(threads_count, 1) * 2;
+  thread_pool pool(std::max<size_t>(std::min(threads_count, chunks_count), 1));
+  std::vector<chunk_result> results;
+  size_t position = start;
+  size_t output_size = 0;
+  for (size_t first = 0; first < chunks_count; first += round_size) {
+    size_t count = std::min(round_size, chunks_count - first);
+    results.assign(count, chunk_result());
+    {
+      stats_timer timer(collect_stats, counters.coding_time);
+      for (size_t j = 0; j < count; ++j) {
+        pool.submit([&, j] {
+          size_t i = first + j;
+          results[j] = decode_chunk(tree_, data, chunk_start(i),
+                                    chunk_start(i + 1), chunk_limit(i),
+                                    nullptr);
+        });
+      }
+      pool.wait();
+    }
+
+    for (size_t j = 0; j < count; ++j) {
+      size_t i = first + j;
+      chunk_result& speculative = results[j];
+      // previous chunk ends at exact code boundary
+      boundary const* found = find(speculative.boundaries, position);
+      boundary synced = found != nullptr ? *found : boundary{NO_POSITION, 0};
+      if (found == nullptr) {
+        chunk_result exact;
+        {
+          stats_timer timer(collect_stats, counters.coding_time);
+          exact = decode_chunk(tree_, data, position, chunk_start(i + 1),
+                               chunk_limit(i), &speculative.boundaries);
+        }
+        {
+          stats_timer timer(collect_stats, counters.io_time);
+          output.write(exact.output.data(), exact.output.size());
+        }
+        output_size += exact.output.size();
+        if (exact.synced.position == NO_POSITION) {
+          // speculative decoding never met exact one
+          position = exact.end;
+          if (position == NO_POSITION) {
+            throw std::runtime_error("Incorrect input");
+          }
+          continue;
+        }
+        synced = exact.synced;
+      }
+      {
+        stats_timer timer(collect_stats, counters.io_time);
+        output.write(speculative.output.data() + synced.chars,
+                     speculative.output.size() - synced.chars);
+      }
+      output_size += speculative.output.size() - synced.chars;
+      position = speculative.end;
+      if (position == NO_POSITION) {
+        throw std::runtime_error("Incorrect input");
+      }
+    }
+  }
+  if (position != end) {
+    throw std::runtime_error("Incorrect input");
+  }
+  add_stats(output_size);
+  return {size, output_size};
+}
+} // namespace huffman
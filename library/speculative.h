@@ -0,0 +1,26 @@
+#pragma once
+
+#include "constants.h"
+#include "stats.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+
+namespace huffman {
+// Decodes legacy stream in memory on threads_count threads. Stream is split
+// to chunks at arbitrary bits, every chunk is decoded from its start as if
+// code started there, remembering code boundaries in its first
+// SYNC_WINDOW_SIZE bits. Exact decoding of previous chunk ends at a code
+// boundary of chunk, and if speculative decoding has the same boundary, they
+// are the same from there. Otherwise chunk is decoded from exact boundary
+// until it meets speculative decoding, or to its end. So output is always
+// the same as of decoder::decode.
+// Returns sizes of input and output, throws std::runtime_error if stream is
+// incorrect or framed. Counters of decoding are added to stats_ if it is
+// given, times are wall times of all threads
+std::pair<size_t, size_t> decode_speculative(
+    uint8_t const* data, size_t size, std::ostream& output,
+    size_t threads_count, size_t chunk_size = SPECULATIVE_CHUNK_SIZE,
+    stats* stats_ = nullptr);
+} // namespace huffman
@@ -0,0 +1,69 @@
+#include "static_table.h"
+
+namespace huffman {
+namespace {
+constexpr size_t BITS_SIZE = 64;
+} // namespace
+
+void static_table::encode(uint8_t const* data, size_t size,
+                          std::string& result) const {
+  uint64_t bits = 0;
+  size_t bits_count = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (sizes[data[i]] == 0) {
+      std::string message("Unexpected char to encode: ");
+      message.append(1, static_cast<char>(data[i]));
+      throw std::runtime_error(message);
+    }
+    bits |= static_cast<uint64_t>(codes[data[i]]) << bits_count;
+    bits_count += sizes[data[i]];
+    while (bits_count >= BYTE_SIZE) {
+      result.push_back(static_cast<char>(bits & 0xFFu));
+      bits >>= BYTE_SIZE;
+      bits_count -= BYTE_SIZE;
+    }
+  }
+  if (bits_count != 0) {
+    result.push_back(static_cast<char>(bits));
+  }
+}
+
+void static_table::decode(uint8_t const* data, size_t data_size, size_t size,
+                          std::string& result) const {
+  result.reserve(result.size() + size);
+  uint64_t bits = 0;
+  size_t bits_count = 0;
+  size_t position = 0;
+  for (size_t i = 0; i < size; ++i) {
+    // at least MAX_CODE_SIZE bits are available, unless data ends
+    while (bits_count <= BITS_SIZE - BYTE_SIZE && position < data_size) {
+      bits |= static_cast<uint64_t>(data[position++]) << bits_count;
+      bits_count += BYTE_SIZE;
+    }
+    lookup_entry entry = lookup[bits & ((uint64_t(1) << LOOKUP_SIZE) - 1)];
+    uint8_t ch = entry.ch;
+    size_t code_size = entry.size;
+    if ((code_size == 0 && !decode_long(bits, ch, code_size)) ||
+        code_size > bits_count) {
+      throw std::runtime_error("Incorrect input");
+    }
+    result.push_back(static_cast<char>(ch));
+    bits >>= code_size;
+    bits_count -= code_size;
+  }
+}
+
+bool static_table::decode_long(uint64_t bits, uint8_t& ch,
+                               size_t& size) const {
+  uint32_t code = 0;
+  for (size = 1; size <= MAX_CODE_SIZE; ++size) {
+    code = (code << 1u) | static_cast<uint32_t>((bits >> (size - 1)) & 1u);
+    if (code >= first_code[size] &&
+        code - first_code[size] < sizes_count[size]) {
+      ch = sorted[first_index[size] + code - first_code[size]];
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace huffman
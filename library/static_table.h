@@ -0,0 +1,120 @@
+#pragma once
+
+#include "constants.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace huffman {
+// Canonical Huffman code, that is known at build time, for example for
+// fixed byte distribution of a protocol. Tables are built by constexpr
+// constructor, so table declared as
+//   static constexpr static_table TABLE(CODE_LENGTHS);
+// is placed to read-only data and has no startup cost.
+// Code lengths can be got from counts by tree::get_code_lengths.
+// Encoded data has no header: codes are followed by zero bits up to a whole
+// byte, number of chars is to be known by decoder
+struct static_table {
+  static constexpr size_t MAX_CODE_SIZE = 32;
+  // codes not longer than that are decoded by one lookup
+  static constexpr size_t LOOKUP_SIZE = 10;
+
+  // throws std::runtime_error if lengths are longer than MAX_CODE_SIZE,
+  // don't form a prefix code or all are zero. Zero length means char is
+  // not used
+  constexpr explicit static_table(
+      std::array<uint8_t, CHARS_COUNT> const& code_lengths) {
+    std::array<size_t, MAX_CODE_SIZE + 1> counts{};
+    for (uint8_t size : code_lengths) {
+      if (size > MAX_CODE_SIZE) {
+        throw std::runtime_error("Incorrect code lengths");
+      }
+      ++counts[size];
+    }
+    counts[0] = 0;
+    // Kraft inequality
+    uint64_t used = 0;
+    for (size_t size = 1; size <= MAX_CODE_SIZE; ++size) {
+      used += static_cast<uint64_t>(counts[size]) << (MAX_CODE_SIZE - size);
+    }
+    if (used == 0 || used > (uint64_t(1) << MAX_CODE_SIZE)) {
+      throw std::runtime_error("Incorrect code lengths");
+    }
+
+    // canonical codes are assigned in order of length, then char
+    std::array<uint32_t, MAX_CODE_SIZE + 1> next_code{};
+    uint32_t code = 0;
+    uint16_t index = 0;
+    for (size_t size = 1; size <= MAX_CODE_SIZE; ++size) {
+      code = (code + static_cast<uint32_t>(counts[size - 1])) << 1u;
+      next_code[size] = code;
+      first_code[size] = code;
+      first_index[size] = index;
+      sizes_count[size] = static_cast<uint16_t>(counts[size]);
+      index += static_cast<uint16_t>(counts[size]);
+    }
+    std::array<uint16_t, MAX_CODE_SIZE + 1> next_index = first_index;
+    for (size_t ch = 0; ch < CHARS_COUNT; ++ch) {
+      uint8_t size = code_lengths[ch];
+      if (size == 0) {
+        continue;
+      }
+      sizes[ch] = size;
+      sorted[next_index[size]++] = static_cast<uint8_t>(ch);
+      // first bit of code is its highest bit, and bits are written from
+      // lower bit of byte, so code is reversed
+      codes[ch] = reverse(next_code[size]++, size);
+      if (size <= LOOKUP_SIZE) {
+        for (size_t rest = 0; rest < (size_t(1) << (LOOKUP_SIZE - size));
+             ++rest) {
+          lookup[codes[ch] | (rest << size)] = {static_cast<uint8_t>(ch),
+                                                size};
+        }
+      }
+    }
+  }
+
+  constexpr size_t code_size(uint8_t ch) const {
+    return sizes[ch];
+  }
+
+  // appends encoded chars to result, throws std::runtime_error if char has
+  // no code
+  void encode(uint8_t const* data, size_t size, std::string& result) const;
+
+  // appends size decoded chars to result, throws std::runtime_error if data
+  // is not correct
+  void decode(uint8_t const* data, size_t data_size, size_t size,
+              std::string& result) const;
+
+private:
+  struct lookup_entry {
+    uint8_t ch{0};
+    // zero if code is longer than LOOKUP_SIZE or there's no such code
+    uint8_t size{0};
+  };
+
+  static constexpr uint32_t reverse(uint32_t code, size_t size) {
+    uint32_t result = 0;
+    for (size_t i = 0; i < size; ++i) {
+      result = (result << 1u) | ((code >> i) & 1u);
+    }
+    return result;
+  }
+
+  bool decode_long(uint64_t bits, uint8_t& ch, size_t& size) const;
+
+  std::array<uint32_t, CHARS_COUNT> codes{};
+  std::array<uint8_t, CHARS_COUNT> sizes{};
+  std::array<lookup_entry, size_t(1) << LOOKUP_SIZE> lookup{};
+  // chars in order of canonical codes
+  std::array<uint8_t, CHARS_COUNT> sorted{};
+  // first code of every length, index of its char in sorted and number of
+  // codes of that length
+  std::array<uint32_t, MAX_CODE_SIZE + 1> first_code{};
+  std::array<uint16_t, MAX_CODE_SIZE + 1> first_index{};
+  std::array<uint16_t, MAX_CODE_SIZE + 1> sizes_count{};
+};
+} // namespace huffman
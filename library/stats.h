@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace huffman {
+// Counters of encoder and decoder work. Times are in nanoseconds and are
+// measured only if collecting stats is enabled
+struct stats {
+  uint64_t counting_time{0};
+  // tree and code tables
+  uint64_t tree_build_time{0};
+  // writing or parsing header
+  uint64_t header_time{0};
+  uint64_t coding_time{0};
+  // waiting for input and output streams
+  uint64_t io_time{0};
+
+  uint64_t input_bytes{0};
+  uint64_t output_bytes{0};
+  uint64_t symbols{0};
+  uint64_t buffer_flushes{0};
+};
+
+// Adds its lifetime to counter if enabled, otherwise doesn't read the clock
+struct stats_timer {
+  stats_timer(bool enabled, uint64_t& counter)
+      : counter(enabled ? &counter : nullptr) {
+    if (enabled) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  stats_timer(stats_timer const& other) = delete;
+
+  stats_timer& operator=(stats_timer const& other) = delete;
+
+  ~stats_timer() {
+    if (counter != nullptr) {
+      *counter += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    }
+  }
+
+private:
+  uint64_t* counter;
+  std::chrono::steady_clock::time_point start;
+};
+} // namespace huffman
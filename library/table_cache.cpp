@@ -0,0 +1,103 @@
+#include "table_cache.h"
+#include <functional>
+
+namespace huffman {
+table_cache::table_cache(size_t bytes) : capacity(bytes) {}
+
+std::shared_ptr<codec const> table_cache::get(uint8_t const* header) {
+  key_buffer buffer; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  std::string_view key = get_key(header, buffer);
+  uint64_t hash = std::hash<std::string_view>()(key);
+  auto find = [&]() -> std::shared_ptr<codec const> {
+    auto [begin, end] = index.equal_range(hash);
+    for (auto it = begin; it != end; ++it) {
+      if (it->second->key == key) {
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->codec_;
+      }
+    }
+    return nullptr;
+  };
+  {
+    std::lock_guard lock(mutex);
+    if (auto result = find()) {
+      return result;
+    }
+  }
+
+  // codec is built without lock, so other threads are not blocked
+  auto result = std::make_shared<codec const>(
+      header, decoder::get_header_size(header[0]));
+  size_t size = result->memory_usage() + key.size();
+
+  std::lock_guard lock(mutex);
+  if (auto cached = find()) {
+    return cached;
+  }
+  if (size <= capacity) {
+    entries.push_front({std::string(key), result, size});
+    index.emplace(hash, entries.begin());
+    memory += size;
+    evict();
+  }
+  return result;
+}
+
+void table_cache::set_capacity(size_t bytes) {
+  std::lock_guard lock(mutex);
+  capacity = bytes;
+  evict();
+}
+
+void table_cache::clear() {
+  std::lock_guard lock(mutex);
+  entries.clear();
+  index.clear();
+  memory = 0;
+}
+
+size_t table_cache::size() const {
+  std::lock_guard lock(mutex);
+  return entries.size();
+}
+
+size_t table_cache::memory_usage() const {
+  std::lock_guard lock(mutex);
+  return memory;
+}
+
+std::string_view table_cache::get_key(uint8_t const* header,
+                                      key_buffer& buffer) {
+  size_t traversal_end =
+      BYTE_SIZE + (header[0] * 2 + 1) * LOG_MAX_NODE_NUMBER;
+  size_t size = (traversal_end + BYTE_SIZE - 1) / BYTE_SIZE;
+  for (size_t i = 0; i < size; ++i) {
+    buffer[i] = static_cast<char>(header[i]);
+  }
+  if (traversal_end % BYTE_SIZE != 0) {
+    buffer[size - 1] = static_cast<char>(
+        header[size - 1] & ((1u << (traversal_end % BYTE_SIZE)) - 1));
+  }
+  return {buffer.data(), size};
+}
+
+table_cache& table_cache::global() {
+  static table_cache result(TABLE_CACHE_SIZE);
+  return result;
+}
+
+void table_cache::evict() {
+  while (memory > capacity) {
+    entry const& last = entries.back();
+    auto [begin, end] = index.equal_range(std::hash<std::string_view>()(last.key));
+    for (auto it = begin; it != end; ++it) {
+      if (it->second == std::prev(entries.end())) {
+        index.erase(it);
+        break;
+      }
+    }
+    memory -= last.size;
+    entries.pop_back();
+  }
+}
+} // namespace huffman
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "codec.h"
+#include "decoder.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace huffman {
+// Thread-safe LRU cache of codecs with decoding tables, keyed by header
+// bytes that contain tree traversal. Codecs are immutable, so they are
+// shared by all decoders, that read identical headers. Memory of cached
+// codecs is bounded by capacity
+struct table_cache {
+  using key_buffer = std::array<char, decoder::MAX_HEADER_SIZE>;
+
+  // capacity in bytes
+  explicit table_cache(size_t bytes);
+
+  table_cache(table_cache const& other) = delete;
+
+  table_cache& operator=(table_cache const& other) = delete;
+
+  ~table_cache() = default;
+
+  // Returns codec of non-empty stream, that starts with whole header,
+  // builds it if it is not cached. Throws std::runtime_error if header is
+  // incorrect
+  std::shared_ptr<codec const> get(uint8_t const* header);
+
+  // 0 disables caching
+  void set_capacity(size_t bytes);
+
+  void clear();
+
+  // number of cached codecs
+  size_t size() const;
+
+  // bytes used by cached codecs
+  size_t memory_usage() const;
+
+  // header bytes with traversal, unused bits of last byte are zero
+  static std::string_view get_key(uint8_t const* header, key_buffer& buffer);
+
+  // cache used by all decoders
+  static table_cache& global();
+
+private:
+  struct entry {
+    std::string key;
+    std::shared_ptr<codec const> codec_;
+    size_t size;
+  };
+
+  void evict();
+
+  mutable std::mutex mutex;
+  size_t capacity;
+  size_t memory{0};
+  // the most recently used first
+  std::list<entry> entries;
+  std::unordered_multimap<uint64_t, std::list<entry>::iterator> index;
+};
+} // namespace huffman
@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace huffman {
+namespace {
+// pool and queue index of worker running on current thread
+thread_local thread_pool const* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+} // namespace
+
+thread_pool::thread_pool(size_t threads_count) {
+  threads_count = std::max<size_t>(threads_count, 1);
+  for (size_t i = 0; i < threads_count; ++i) {
+    queues.push_back(std::make_unique<task_queue>());
+  }
+  for (size_t i = 0; i < threads_count; ++i) {
+    threads.emplace_back([this, i] { work(i); });
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+    stopping = true;
+  }
+  has_tasks.notify_all();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+void thread_pool::submit(std::function<void()> task) {
+  size_t idx = current_pool == this
+                   ? current_queue
+                   : next_queue.fetch_add(1) % queues.size();
+  {
+    // counted before task is published, so it can't finish before that
+    std::lock_guard lock(mutex);
+    ++pending;
+  }
+  {
+    std::lock_guard lock(queues[idx]->mutex);
+    queues[idx]->tasks.push_back(std::move(task));
+  }
+  {
+    // idle worker checks queues under the lock, so it can't miss the task
+    std::lock_guard lock(mutex);
+    has_tasks.notify_one();
+  }
+}
+
+void thread_pool::wait() {
+  std::unique_lock lock(mutex);
+  finished.wait(lock, [this] { return pending == 0; });
+  if (error != nullptr) {
+    std::exception_ptr result = nullptr;
+    std::swap(result, error);
+    std::rethrow_exception(result);
+  }
+}
+
+size_t thread_pool::size() const {
+  return threads.size();
+}
+
+bool thread_pool::pop(size_t idx, std::function<void()>& task) {
+  // own tasks are taken from back, so recently submitted subtasks run
+  // while their data is hot, others' tasks are stolen from front
+  for (size_t i = 0; i < queues.size(); ++i) {
+    task_queue& queue = *queues[(idx + i) % queues.size()];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+bool thread_pool::has_queued() {
+  for (std::unique_ptr<task_queue>& queue : queues) {
+    std::lock_guard lock(queue->mutex);
+    if (!queue->tasks.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void thread_pool::work(size_t idx) {
+  current_pool = this;
+  current_queue = idx;
+  while (true) {
+    std::function<void()> task;
+    if (pop(idx, task)) {
+      try {
+        task();
+      } catch (...) {
+        std::lock_guard lock(mutex);
+        if (error == nullptr) {
+          error = std::current_exception();
+        }
+      }
+      std::lock_guard lock(mutex);
+      if (--pending == 0) {
+        finished.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock lock(mutex);
+    has_tasks.wait(lock, [this] { return stopping || has_queued(); });
+    if (stopping && !has_queued()) {
+      return;
+    }
+  }
+}
+} // namespace huffman
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace huffman {
+// Work-stealing thread pool: every worker has its own deque, tasks submitted
+// by a worker go to its deque, idle workers steal from others
+struct thread_pool {
+  explicit thread_pool(size_t threads_count);
+
+  thread_pool(thread_pool const& other) = delete;
+
+  thread_pool& operator=(thread_pool const& other) = delete;
+
+  // waits for all submitted tasks
+  ~thread_pool();
+
+  // can be called from tasks
+  void submit(std::function<void()> task);
+
+  // waits for all submitted tasks, including ones submitted by other tasks,
+  // rethrows first exception thrown by a task
+  void wait();
+
+  size_t size() const;
+
+private:
+  struct task_queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void work(size_t idx);
+  bool pop(size_t idx, std::function<void()>& task);
+  // whether any queue has a task, called under mutex by idle workers
+  bool has_queued();
+
+  std::vector<std::unique_ptr<task_queue>> queues;
+  std::vector<std::thread> threads;
+
+  std::atomic<size_t> next_queue{0};
+
+  std::mutex mutex;
+  std::condition_variable has_tasks;
+  std::condition_variable finished;
+  size_t pending{0};
+  bool stopping{false};
+  std::exception_ptr error{nullptr};
+};
+} // namespace huffman
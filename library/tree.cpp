@@ -1,108 +1,185 @@
 #include "tree.h"
 #include <algorithm>
 #include <cassert>
-#include <queue>
 #include <stdexcept>
 #include <string>
 #include <utility>
 
 namespace huffman {
-tree::tree(std::array<size_t, CHARS_COUNT> const& counts) {
-  // first - count, second - index of leaf, third - char
-  std::vector<std::tuple<size_t, size_t, uint8_t>> first_array;
-  size_t actual_size = 0;
-  for (size_t i = 0; i < CHARS_COUNT; ++i) {
-    if (counts[i] != 0) {
-      first_array.emplace_back(counts[i], actual_size++, i);
+namespace {
+constexpr size_t MAX_NODES_COUNT = 2 * CHARS_COUNT - 1;
+
+// Builds Huffman tree without allocations by two-queue algorithm:
+// leafs sorted by count form the first queue, internal nodes are created in
+// non-decreasing order of weight, so they form the second one. Leafs have
+// indexes [0, leafs_count), internal nodes - [leafs_count, 2 * leafs_count - 1)
+struct tree_builder {
+  explicit tree_builder(std::array<size_t, CHARS_COUNT> const& counts) {
+    for (size_t i = 0; i < CHARS_COUNT; ++i) {
+      if (counts[i] != 0) {
+        symbols[leafs_count++] = i;
+      }
+    }
+    if (leafs_count < 2) {
+      return;
+    }
+    // ties are broken by char, so tree doesn't depend on sort implementation
+    std::sort(symbols.begin(), symbols.begin() + leafs_count,
+              [&counts](uint8_t a, uint8_t b) {
+                return counts[a] < counts[b] ||
+                       (counts[a] == counts[b] && a < b);
+              });
+    std::array<size_t, MAX_NODES_COUNT> weights; // NOLINT(cppcoreguidelines-pro-type-member-init)
+    for (size_t i = 0; i < leafs_count; ++i) {
+      weights[i] = counts[symbols[i]];
+    }
+    size_t next_leaf = 0;
+    size_t next_node = leafs_count;
+    size_t nodes_count = leafs_count;
+    auto take_min = [&]() {
+      if (next_leaf < leafs_count &&
+          (next_node == nodes_count || weights[next_leaf] <= weights[next_node])) {
+        return next_leaf++;
+      }
+      return next_node++;
+    };
+    for (size_t i = 0; i + 1 < leafs_count; ++i) {
+      size_t left = take_min();
+      size_t right = take_min();
+      weights[nodes_count] = weights[left] + weights[right];
+      children[2 * i] = static_cast<uint16_t>(left);
+      children[2 * i + 1] = static_cast<uint16_t>(right);
+      parents[left] = nodes_count;
+      parents[right] = nodes_count;
+      ++nodes_count;
     }
+    parents[nodes_count - 1] = nodes_count - 1;
   }
-  if (actual_size == 0) {
+
+  size_t leafs_count{0};
+  std::array<uint8_t, CHARS_COUNT> symbols{};
+  std::array<uint16_t, MAX_NODES_COUNT> parents{};
+  std::array<uint16_t, 2 * (CHARS_COUNT - 1)> children{};
+};
+} // namespace
+
+tree::tree(std::array<size_t, CHARS_COUNT> const& counts) {
+  tree_builder builder(counts);
+  if (builder.leafs_count == 0) {
     throw std::runtime_error("Counts is zero, tree cannot be built");
   }
-  if (actual_size == 1) {
+  if (builder.leafs_count == 1) {
     root = 2;
-    children.emplace_back(0, 1);
+    children = {0, 1};
     parents.resize(3, 2);
-    leafs.push_back(std::get<2>(first_array[0]));
+    leafs.push_back(builder.symbols[0]);
     leafs.push_back(leafs.back());
     return;
   }
-  root = 2 * actual_size - 2;
-  parents.resize(2 * actual_size - 1);
-  parents[root] = root;
-  leafs.resize(actual_size);
-  children.resize(actual_size - 1);
-  // pair is: first - count, second - index
-  std::priority_queue<std::pair<size_t, size_t>,
-      std::vector<std::pair<size_t, size_t>>,
-      std::greater<>> pq;
-  for (size_t i = 0; i < actual_size; ++i) {
-    pq.emplace(std::get<0>(first_array[i]), std::get<1>(first_array[i]));
-    leafs[std::get<1>(first_array[i])] = std::get<2>(first_array[i]);
-  }
-  for (size_t i = 0; i < leafs.size() - 1; ++i) {
-    std::pair<size_t, size_t> left = pq.top();
-    pq.pop();
-    std::pair<size_t, size_t> right = pq.top();
-    pq.pop();
-    children[actual_size - leafs.size()] = {left.second, right.second};
-    parents[left.second] = actual_size;
-    parents[right.second] = actual_size;
-    pq.emplace(left.first + right.first, actual_size++);
-  }
-  assert(actual_size == 2 * leafs.size() - 1);
-  assert(actual_size = leafs.size() + children.size());
+  size_t leafs_count = builder.leafs_count;
+  root = static_cast<uint16_t>(2 * leafs_count - 2);
+  leafs.assign(builder.symbols.begin(), builder.symbols.begin() + leafs_count);
+  children.assign(builder.children.begin(),
+                  builder.children.begin() + 2 * (leafs_count - 1));
+  parents.assign(builder.parents.begin(),
+                 builder.parents.begin() + 2 * leafs_count - 1);
+}
+
+void tree::get_code_lengths(std::array<size_t, CHARS_COUNT> const& counts,
+                            std::array<uint8_t, CHARS_COUNT>& result) {
+  result.fill(0);
+  tree_builder builder(counts);
+  if (builder.leafs_count < 2) {
+    if (builder.leafs_count == 1) {
+      result[builder.symbols[0]] = 1;
+    }
+    return;
+  }
+  // parent always has bigger index than its children
+  std::array<uint8_t, MAX_NODES_COUNT> depths; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  size_t root_ = 2 * builder.leafs_count - 2;
+  depths[root_] = 0;
+  for (size_t node = root_; node-- > 0;) {
+    depths[node] = depths[builder.parents[node]] + 1;
+  }
+  for (size_t i = 0; i < builder.leafs_count; ++i) {
+    result[builder.symbols[i]] = depths[i];
+  }
 }
 
-tree::tree(std::vector<uint16_t> const& traversal) {
-  assert(traversal.size() % 2 == 1);
-  leafs.resize(traversal.size() / 2 + 1);
-  children.resize(leafs.size() - 1);
-  parents.resize(traversal.size());
-  root = leafs.size();
+tree::tree(std::vector<uint16_t> const& traversal)
+    : tree(traversal.data(), traversal.size()) {}
+
+tree::tree(uint16_t const* traversal, size_t size) {
+  if (size < 3 || size % 2 == 0) {
+    throw std::runtime_error("Incorrect traversal, tree cannot be built");
+  }
+  leafs.resize(size / 2 + 1);
+  children.resize(2 * (leafs.size() - 1));
+  parents.resize(size);
+  root = static_cast<uint16_t>(leafs.size());
   size_t leaf_count = 0;
   size_t node_count = 0;
-  std::vector<size_t> indexes;
-  for (uint16_t code : traversal) {
-    if (code < CHARS_COUNT) {
-      leafs[leaf_count] = code;
-      indexes.push_back(leaf_count++);
+  // internal nodes, which right child is not read yet
+  std::array<size_t, CHARS_COUNT> need_right; // NOLINT(cppcoreguidelines-pro-type-member-init)
+  size_t need_right_size = 0;
+  size_t previous = root;
+  for (size_t i = 0; i < size; ++i) {
+    size_t current; // NOLINT(cppcoreguidelines-init-variables)
+    if (traversal[i] < CHARS_COUNT && leaf_count < leafs.size()) {
+      leafs[leaf_count] = traversal[i];
+      current = leaf_count++;
+    } else if (traversal[i] == CHARS_COUNT &&
+               node_count + 1 < leafs.size()) {
+      current = leafs.size() + node_count++;
     } else {
-      indexes.push_back(leafs.size() + node_count++);
+      throw std::runtime_error("Incorrect traversal, tree cannot be built");
     }
-  }
-  std::vector<size_t> need_right_queue;
-  for (size_t i = 0; i < traversal.size() - 1; ++i) {
-    if (traversal[i] == CHARS_COUNT) {
-      children[indexes[i] - leafs.size()].first = indexes[i + 1];
-      parents[indexes[i + 1]] = indexes[i];
-      need_right_queue.push_back(indexes[i]);
+    if (i == 0) {
+      if (current != root) {
+        throw std::runtime_error("Incorrect traversal, tree cannot be built");
+      }
+      parents[root] = root;
+    } else if (previous >= leafs.size()) {
+      // node after internal one is its left child
+      children[2 * (previous - leafs.size())] =
+          static_cast<uint16_t>(current);
+      parents[current] = static_cast<uint16_t>(previous);
+      need_right[need_right_size++] = previous;
     } else {
-      children[need_right_queue.back() - leafs.size()].second = indexes[i + 1];
-      parents[indexes[i + 1]] = need_right_queue.back();
-      need_right_queue.pop_back();
+      // node after leaf is right child of the deepest node that lacks it
+      if (need_right_size == 0) {
+        throw std::runtime_error("Incorrect traversal, tree cannot be built");
+      }
+      size_t parent = need_right[--need_right_size];
+      children[2 * (parent - leafs.size()) + 1] =
+          static_cast<uint16_t>(current);
+      parents[current] = static_cast<uint16_t>(parent);
     }
+    previous = current;
+  }
+  if (need_right_size != 0) {
+    throw std::runtime_error("Incorrect traversal, tree cannot be built");
   }
-  assert(need_right_queue.empty());
+  get_table();
 }
 void tree::get_codes(std::array<bit_sequence, CHARS_COUNT>& result) const {
   bit_sequence current_code;
   size_t current_node = root;
   std::vector<bool> visited(parents.size(), false);
   size_t count = 0;
-  while (++count != leafs.size() + 3 * children.size()) {
+  while (++count != leafs.size() + 3 * (leafs.size() - 1)) {
     visited[current_node] = true;
     if (current_node < leafs.size()) {
       result[leafs[current_node]] = current_code;
       current_code.pop_back();
       current_node = parents[current_node];
     } else {
-      auto child = children[current_node - leafs.size()];
-      if (!visited[child.first]) {
-        current_node = child.first;
+      if (!visited[child(current_node, false)]) {
+        current_node = child(current_node, false);
         current_code.append(false);
-      } else if (!visited[child.second]) {
-        current_node = child.second;
+      } else if (!visited[child(current_node, true)]) {
+        current_node = child(current_node, true);
         current_code.append(true);
       } else {
         current_code.pop_back();
@@ -125,7 +202,7 @@ bit_sequence tree::traversal() const { // NOLINT(misc-no-recursion)
   bit_sequence result;
   size_t current_node = root;
   size_t count = 0;
-  while (++count != leafs.size() + 3 * children.size()) {
+  while (++count != leafs.size() + 3 * (leafs.size() - 1)) {
     if (!visited[current_node]) {
       uint16_t number =
           current_node < leafs.size() ? leafs[current_node] : CHARS_COUNT;
@@ -135,11 +212,10 @@ bit_sequence tree::traversal() const { // NOLINT(misc-no-recursion)
     if (current_node < leafs.size()) {
       current_node = parents[current_node];
     } else {
-      auto child = children[current_node - leafs.size()];
-      if (!visited[child.first]) {
-        current_node = child.first;
-      } else if (!visited[child.second]) {
-        current_node = child.second;
+      if (!visited[child(current_node, false)]) {
+        current_node = child(current_node, false);
+      } else if (!visited[child(current_node, true)]) {
+        current_node = child(current_node, true);
       } else {
         current_node = parents[current_node];
       }
@@ -153,59 +229,118 @@ bool tree::get_char(bit_sequence const& code,
                     uint8_t& result) const {
   return get_char(code, idx, result, root);
 }
-std::vector<std::vector<std::pair<std::vector<uint8_t>, size_t>>>
-tree::get_shortcuts() const {
-  auto result =
-      std::vector<std::vector<std::pair<std::vector<uint8_t>, size_t>>>();
-  for (size_t i = 0; i < children.size(); ++i) {
-    result.emplace_back();
+std::vector<tree::shortcut> tree::get_shortcuts() const {
+  size_t internal_count = leafs.size() - 1;
+  std::vector<shortcut> result(internal_count * TREE_SHORTCUT_CHARS_COUNT);
+  for (size_t i = 0; i < internal_count; ++i) {
     for (size_t j = 0; j < TREE_SHORTCUT_CHARS_COUNT; ++j) {
-      std::vector<uint8_t> decoded;
+      shortcut& decoded = result[i * TREE_SHORTCUT_CHARS_COUNT + j];
+      decoded.chars_count = 0;
       size_t current_node = i + leafs.size();
       size_t path = j;
       for (size_t k = 0; k < TREE_SHORTCUT_SIZE; ++k) {
-        if ((path & 1u) == 0) {
-          current_node = children[current_node - leafs.size()].first;
-        } else {
-          current_node = children[current_node - leafs.size()].second;
-        }
+        current_node = child(current_node, (path & 1u) != 0);
         if (current_node < leafs.size()) {
-          decoded.push_back(leafs[current_node]);
+          decoded.chars[decoded.chars_count++] = leafs[current_node];
           current_node = root;
         }
         path >>= 1;
       }
-      result.back().emplace_back(std::move(decoded), current_node);
+      decoded.next = static_cast<uint16_t>((current_node - leafs.size()) *
+                                           TREE_SHORTCUT_CHARS_COUNT);
     }
   }
   return result;
 }
-std::pair<size_t, size_t> tree::dump(bit_sequence const& buffer,
-                                     size_t last_idx, std::ostream& output) {
-  size_t current_node = root;
-  size_t idx = 0;
-  if (!calculated_shortcuts) {
+size_t tree::memory_usage() const {
+  size_t result = leafs.capacity() * sizeof(uint8_t) +
+                  children.capacity() * sizeof(children[0]) +
+                  parents.capacity() * sizeof(parents[0]) +
+                  (has_table.load(std::memory_order_acquire)
+                       ? shortcuts.capacity() * sizeof(shortcut)
+                       : 0);
+  return result;
+}
+std::vector<tree::shortcut> const& tree::get_table() const {
+  std::call_once(table_built, [this] {
     shortcuts = get_shortcuts();
-    calculated_shortcuts = true;
+    has_table.store(true, std::memory_order_release);
+  });
+  return shortcuts;
+}
+size_t tree::memory_usage(size_t leafs_count) {
+  return leafs_count * sizeof(uint8_t) +
+         (4 * leafs_count - 3) * sizeof(uint16_t) +
+         (leafs_count - 1) * TREE_SHORTCUT_CHARS_COUNT * sizeof(shortcut);
+}
+namespace {
+struct string_output {
+  std::string& result;
+
+  bool has_room(size_t /*count*/) const {
+    return true;
+  }
+
+  void append(uint8_t const* chars, size_t size) {
+    result.append(reinterpret_cast<char const*>(chars), size);
+  }
+};
+
+struct span_output {
+  uint8_t* data;
+  size_t capacity;
+  size_t size{0};
+
+  bool has_room(size_t count) const {
+    return size + count <= capacity;
+  }
+
+  void append(uint8_t const* chars, size_t count) {
+    std::copy(chars, chars + count, data + size);
+    size += count;
   }
-  std::string result;
-  while (idx + TREE_SHORTCUT_SIZE <= last_idx) {
+};
+} // namespace
+
+std::pair<size_t, size_t> tree::dump(bit_sequence const& buffer,
+                                     size_t last_idx,
+                                     std::string& result) const {
+  string_output output{result};
+  return dump_to(buffer, last_idx, output);
+}
+
+std::pair<size_t, size_t> tree::dump(bit_sequence const& buffer,
+                                     size_t last_idx, uint8_t* output,
+                                     size_t capacity) const {
+  span_output span{output, capacity};
+  return dump_to(buffer, last_idx, span);
+}
+
+template <typename Output>
+std::pair<size_t, size_t> tree::dump_to(bit_sequence const& buffer,
+                                        size_t last_idx,
+                                        Output& output) const {
+  std::vector<shortcut> const& table = get_table();
+  size_t row = (root - leafs.size()) * TREE_SHORTCUT_CHARS_COUNT;
+  size_t idx = 0;
+  size_t write_size = 0;
+  // every shortcut gives at most TREE_SHORTCUT_SIZE chars
+  while (idx + TREE_SHORTCUT_SIZE <= last_idx &&
+         output.has_room(TREE_SHORTCUT_SIZE)) {
     uint8_t next_bits = buffer.get_number(TREE_SHORTCUT_SIZE, idx);
-    auto tmp = shortcuts[current_node - leafs.size()][next_bits];
-    for (uint8_t output_byte : tmp.first) {
-      result.push_back(static_cast<char>(output_byte));
-    }
-    current_node = tmp.second;
+    shortcut const& tmp = table[row + next_bits];
+    output.append(tmp.chars.data(), tmp.chars_count);
+    write_size += tmp.chars_count;
+    row = tmp.next;
     idx += TREE_SHORTCUT_SIZE;
   }
-  size_t write_size = result.size();
-  output.write(result.data(), static_cast<std::streamsize>(result.size()));
+  size_t current_node = row / TREE_SHORTCUT_CHARS_COUNT + leafs.size();
   size_t next_idx = idx;
   uint8_t next_byte; // NOLINT(cppcoreguidelines-init-variables)
-  while (next_idx < last_idx &&
+  while (next_idx < last_idx && output.has_room(1) &&
          get_char(buffer, next_idx, next_byte, current_node)) {
     current_node = root;
-    output.put(static_cast<char>(next_byte));
+    output.append(&next_byte, 1);
     ++write_size;
     idx = next_idx;
   }
@@ -227,11 +362,10 @@ bool tree::get_char(const bit_sequence& code,
     if (idx == code.size()) {
       return false;
     }
-    if (code[idx++]) {
-      current_node = children[current_node - leafs.size()].second;
-    } else {
-      current_node = children[current_node - leafs.size()].first;
-    }
+    current_node = child(current_node, code[idx++]);
   }
 }
+size_t tree::child(size_t node, bool right) const {
+  return children[2 * (node - leafs.size()) + (right ? 1 : 0)];
+}
 } // namespace huffman
@@ -3,8 +3,10 @@
 #include "bit_sequence.h"
 #include "constants.h"
 #include <array>
+#include <atomic>
 #include <cstdint>
-#include <ostream>
+#include <mutex>
+#include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -22,32 +24,76 @@ struct tree {
 
   explicit tree(std::vector<uint16_t> const& traversal);
 
+  // throws std::runtime_error if traversal is not a correct tree.
+  // Decoding tables are built at once, so tree is immutable after
+  // construction and can be shared by several decoders
+  tree(uint16_t const* traversal, size_t size);
+
   ~tree() = default;
 
   void get_codes(std::array<bit_sequence, CHARS_COUNT>& result) const;
 
+  // Code lengths of tree built from counts, without building the tree.
+  // Zero for chars with zero count
+  static void get_code_lengths(std::array<size_t, CHARS_COUNT> const& counts,
+                               std::array<uint8_t, CHARS_COUNT>& result);
+
   bit_sequence header() const;
 
   bool get_char(bit_sequence const& code, size_t& idx, uint8_t& result) const;
 
+  // appends decoded chars to result. Tree built from traversal has decoding
+  // tables at once, tree built from counts builds them at the first dump
   std::pair<size_t, size_t> dump(bit_sequence const& buffer, size_t last_idx,
-              std::ostream& output);
+                                 std::string& result) const;
 
-private:
+  // writes decoded chars straight to output, stops when capacity chars are
+  // written, so caller checks whether all bits are decoded
+  std::pair<size_t, size_t> dump(bit_sequence const& buffer, size_t last_idx,
+                                 uint8_t* output, size_t capacity) const;
+
+  // bytes allocated for nodes and decoding tables
+  size_t memory_usage() const;
 
-  // first idx - node index, second - TREE_SHORTCUT_SIZE-bit number
-  std::vector<std::vector<std::pair<std::vector<uint8_t>, size_t>>>
-  get_shortcuts() const;
+  // memory_usage of tree with leafs_count leafs built from traversal, so
+  // memory is checked before tree is built
+  static size_t memory_usage(size_t leafs_count);
+
+private:
+  // result of walking TREE_SHORTCUT_SIZE bits from internal node, packed
+  // to 8 bytes, so table of the biggest tree fits in L1 cache
+  struct shortcut {
+    std::array<uint8_t, TREE_SHORTCUT_SIZE> chars;
+    uint8_t chars_count;
+    // index of the first shortcut of internal node reached
+    uint16_t next;
+  };
+
+  // index is internal node index * TREE_SHORTCUT_CHARS_COUNT +
+  // TREE_SHORTCUT_SIZE-bit number
+  std::vector<shortcut> get_shortcuts() const;
+  // builds decoding tables once, even if tree is dumped by several threads
+  std::vector<shortcut> const& get_table() const;
   bit_sequence traversal() const;
+  size_t child(size_t node, bool right) const;
   bool get_char(bit_sequence const& code, size_t& idx, uint8_t& result,
                 size_t start_node) const;
-
-  bool calculated_shortcuts{false};
-  std::vector<std::vector<std::pair<std::vector<uint8_t>, size_t>>> shortcuts;
-
-  size_t root;
+  // Output is appended to by decoded chars, see string_output and
+  // span_output in tree.cpp
+  template <typename Output>
+  std::pair<size_t, size_t> dump_to(bit_sequence const& buffer,
+                                    size_t last_idx, Output& output) const;
+
+  mutable std::once_flag table_built;
+  // set after table is built, so memory_usage doesn't race with building
+  mutable std::atomic<bool> has_table{false};
+  mutable std::vector<shortcut> shortcuts;
+
+  // nodes are indexed by 16 bits, as there are at most 511 of them
+  uint16_t root;
   std::vector<uint8_t> leafs;
-  std::vector<std::pair<size_t, size_t>> children;
-  std::vector<size_t> parents;
+  // left and right children of internal node i are at 2 * i and 2 * i + 1
+  std::vector<uint16_t> children;
+  std::vector<uint16_t> parents;
 };
 } // namespace huffman
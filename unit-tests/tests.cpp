@@ -1,17 +1,49 @@
+#include "batch.h"
 #include "bit_sequence.h"
+#include "codec.h"
+#include "crc32c.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "filter.h"
+#include "frame.h"
+#include "messages.h"
+#include "partition.h"
+#include "sampling.h"
+#include "search.h"
+#include "server.h"
+#include "speculative.h"
+#include "static_table.h"
+#include "table_cache.h"
+#include "thread_pool.h"
 #include "tree.h"
 #include "gtest/gtest.h"
 #include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <set>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 using huffman::bit_sequence;
+using huffman::crc32c;
+using huffman::decode_speculative;
 using huffman::decoder;
 using huffman::encoder;
+using huffman::message;
+using huffman::message_decoder;
+using huffman::static_table;
+using huffman::table_cache;
+using huffman::thread_pool;
 using huffman::tree;
 
 static constexpr size_t N = 10000;
@@ -187,6 +219,22 @@ TEST(bit_sequence, swap3) {
   }
 }
 
+TEST(bit_sequence, erase_front) {
+  for (size_t count : {0, 1, 63, 64, 65, 130, 200}) {
+    bit_sequence seq;
+    for (size_t i = 0; i < 200; ++i) {
+      seq.append(i % 3 == 0);
+    }
+    seq.erase_front(count);
+    ASSERT_EQ(200 - count, seq.size());
+    for (size_t i = 0; i < seq.size(); ++i) {
+      ASSERT_EQ((i + count) % 3 == 0, seq[i]);
+    }
+    seq.append(true);
+    ASSERT_TRUE(seq[seq.size() - 1]);
+  }
+}
+
 TEST(tree, uniform_distr) {
   std::array<size_t, huffman::CHARS_COUNT> counts{};
   counts.fill(1);
@@ -282,6 +330,35 @@ TEST(tree, code_lengths2) {
   ASSERT_EQ(2, codes[6].size());
 }
 
+TEST(tree, code_lengths_without_tree) {
+  std::array<size_t, huffman::CHARS_COUNT> fibonacci{};
+  fibonacci[0] = 1;
+  fibonacci[1] = 1;
+  for (size_t i = 2; i < 40; ++i) {
+    fibonacci[i] = fibonacci[i - 1] + fibonacci[i - 2];
+  }
+  std::array<size_t, huffman::CHARS_COUNT> random{};
+  for (size_t i = 0; i < huffman::CHARS_COUNT; ++i) {
+    random[i] = (i * i * 7 + 13) % 101;
+  }
+  std::array<size_t, huffman::CHARS_COUNT> single{};
+  single[42] = 5;
+
+  std::array<uint8_t, huffman::CHARS_COUNT> lengths{};
+  for (auto const& counts : {fibonacci, random, single}) {
+    tree tree_(counts);
+    std::array<bit_sequence, huffman::CHARS_COUNT> codes{};
+    tree_.get_codes(codes);
+    tree::get_code_lengths(counts, lengths);
+    for (size_t i = 0; i < huffman::CHARS_COUNT; ++i) {
+      ASSERT_EQ(codes[i].size(), lengths[i]);
+    }
+  }
+  tree::get_code_lengths(fibonacci, lengths);
+  ASSERT_EQ(39, lengths[0]);
+  ASSERT_EQ(1, lengths[39]);
+}
+
 TEST(tree, traversal_header_constructor) {
   std::array<size_t, huffman::CHARS_COUNT> counts{};
   // "random" tree
@@ -320,6 +397,17 @@ TEST(tree, traversal_header_constructor) {
   }
 }
 
+TEST(tree, incorrect_traversal) {
+  using traversal = std::vector<uint16_t>;
+  for (traversal const& nodes :
+       {traversal{}, traversal{1}, traversal{256, 1}, traversal{1, 256, 2},
+        traversal{256, 256, 1, 2, 3, 4, 5}, traversal{256, 1, 2, 3, 4},
+        traversal{256, 256, 256, 1, 2}, traversal{256, 1, 257}}) {
+    EXPECT_THROW(tree tree_(nodes), std::runtime_error);
+  }
+  EXPECT_NO_THROW(tree tree_(traversal{256, 256, 1, 2, 3}));
+}
+
 TEST(tree, get_char) {
   std::array<size_t, huffman::CHARS_COUNT> counts{};
   // "random" tree
@@ -349,6 +437,31 @@ TEST(tree, get_char) {
   }
 }
 
+TEST(tree, dump_from_counts) {
+  std::array<size_t, huffman::CHARS_COUNT> counts{};
+  for (size_t i = 0; i < huffman::CHARS_COUNT; ++i) {
+    counts[i] = i % 7;
+  }
+  tree tree_(counts);
+  size_t memory = tree_.memory_usage();
+  std::array<bit_sequence, huffman::CHARS_COUNT> codes{};
+  tree_.get_codes(codes);
+  std::string expected;
+  bit_sequence encoded;
+  for (size_t i = 0; i < N; ++i) {
+    auto ch = static_cast<uint8_t>(i * i % huffman::CHARS_COUNT);
+    if (counts[ch] != 0) {
+      expected.push_back(static_cast<char>(ch));
+      encoded.append(codes[ch]);
+    }
+  }
+  // decoding tables are built by the first dump
+  std::string decoded;
+  ASSERT_EQ(encoded.size(), tree_.dump(encoded, encoded.size(), decoded).first);
+  ASSERT_EQ(expected, decoded);
+  ASSERT_LT(memory, tree_.memory_usage());
+}
+
 TEST(tree, empty) {
   std::array<size_t, huffman::CHARS_COUNT> counts{};
   counts.fill(0);
@@ -436,6 +549,43 @@ TEST(encoder, codes) {
     }
   }
 }
+TEST(encoder, output_size) {
+  for (size_t modulo : {1, 2, 7, 97, 256}) {
+    std::string input;
+    for (size_t i = 0; i < N; ++i) {
+      input.push_back(static_cast<char>((i * i + (i & 1234)) % modulo));
+    }
+    encoder encoder_;
+    encoder_.add_chars(reinterpret_cast<uint8_t const*>(input.data()),
+                       input.size());
+    encoder_.compile();
+    size_t estimated = encoder_.get_output_size();
+
+    std::stringstream encoder_input(input);
+    std::stringstream encoder_output;
+    encoder_.encode(encoder_input, encoder_output);
+    ASSERT_EQ(encoder_output.str().size(), estimated);
+  }
+}
+
+TEST(encoder, entropy) {
+  encoder uniform;
+  for (size_t i = 0; i < N; ++i) {
+    uniform.add_char(i % 256);
+  }
+  ASSERT_NEAR(8, uniform.get_entropy(), 1e-2);
+
+  encoder single;
+  single.add_char(42);
+  single.add_char(42);
+  ASSERT_EQ(0, single.get_entropy());
+
+  encoder halves;
+  halves.add_char(1);
+  halves.add_char(2);
+  ASSERT_DOUBLE_EQ(1, halves.get_entropy());
+}
+
 TEST(correctness, streams) {
   encoder encoder_;
   std::string test_string =
@@ -461,3 +611,1206 @@ TEST(correctness, streams) {
 
   ASSERT_EQ(test_string, decoder_output.str());
 }
+
+TEST(crc32c, known_values) {
+  std::string check = "123456789";
+  crc32c whole;
+  whole.update(reinterpret_cast<uint8_t const*>(check.data()), check.size());
+  ASSERT_EQ(0xE3069283u, whole.value());
+
+  crc32c parts;
+  for (char ch : check) {
+    parts.update(reinterpret_cast<uint8_t const*>(&ch), 1);
+  }
+  ASSERT_EQ(whole.value(), parts.value());
+
+  ASSERT_EQ(0u, crc32c().value());
+}
+
+// deterministic data with uneven counts of chars_count chars
+static std::string make_input(size_t size, size_t chars_count = 97) {
+  std::string result;
+  for (size_t i = 0; i < size; ++i) {
+    result.push_back(static_cast<char>((i * i + (i & 1234)) % chars_count));
+  }
+  return result;
+}
+
+static std::string encode_framed(std::string const& input,
+                                 uint8_t flags = huffman::FRAME_FLAG_CHECKSUM) {
+  encoder encoder_;
+  std::stringstream count_stream(input);
+  encoder_.add_chars(count_stream);
+  std::stringstream encoder_input(input);
+  std::stringstream encoder_output;
+  encoder_.encode_framed(encoder_input, encoder_output, flags);
+  return encoder_output.str();
+}
+
+static std::string encode_legacy(std::string const& input) {
+  encoder encoder_;
+  std::stringstream count_stream(input);
+  encoder_.add_chars(count_stream);
+  std::stringstream encoder_input(input);
+  std::stringstream encoder_output;
+  encoder_.encode(encoder_input, encoder_output);
+  return encoder_output.str();
+}
+
+static std::string decode(std::string const& input) {
+  std::stringstream decoder_input(input);
+  std::stringstream decoder_output;
+  decoder decoder_;
+  decoder_.decode(decoder_input, decoder_output);
+  return decoder_output.str();
+}
+
+TEST(correctness, framed) {
+  std::string test_string = make_input(N);
+  for (std::string const& input : {test_string, std::string(), std::string("a")}) {
+    std::string encoded = encode_framed(input);
+    ASSERT_EQ(0, encoded[0]);
+    ASSERT_EQ(input, decode(encoded));
+  }
+}
+
+TEST(correctness, framed_corrupted) {
+  std::string test_string = make_input(N);
+  std::string encoded = encode_framed(test_string);
+  // every flipped bit after the magic must be detected
+  for (size_t i = huffman::FRAME_MAGIC.size(); i < encoded.size();
+       i += encoded.size() / 50) {
+    std::string corrupted(encoded);
+    corrupted[i] = static_cast<char>(corrupted[i] ^ (1 << (i % 8)));
+    EXPECT_THROW(decode(corrupted), std::runtime_error) << i;
+  }
+  EXPECT_THROW(decode(encoded.substr(0, encoded.size() - 1)),
+               std::runtime_error);
+  EXPECT_THROW(decode(encoded.substr(0, encoded.size() / 2)),
+               std::runtime_error);
+}
+
+TEST(correctness, framed_members) {
+  std::string first(N, 'a');
+  std::string second;
+  for (size_t i = 0; i < N; ++i) {
+    second.push_back(static_cast<char>(i % 256));
+  }
+  std::string encoded =
+      encode_framed(first) + encode_framed(std::string()) + encode_framed(second);
+  ASSERT_EQ(first + second, decode(encoded));
+  EXPECT_THROW(decode(encoded + "x"), std::runtime_error);
+}
+
+TEST(correctness, truncated_header) {
+  std::string encoded = encode_framed(std::string(N, 'a') + "bcd");
+  std::string legacy = encoded.substr(huffman::FRAME_HEADER_SIZE, 5);
+  EXPECT_THROW(decode(legacy), std::runtime_error);
+  EXPECT_THROW(decode(std::string()), std::runtime_error);
+}
+
+TEST(correctness, format_versions) {
+  std::string input(N, 'a');
+  input += "bcd";
+  size_t version_index = huffman::FRAME_MAGIC.size();
+
+  std::string unchecked = encode_framed(input, 0);
+  ASSERT_EQ(encode_framed(input).size(),
+            unchecked.size() + huffman::FRAME_TRAILER_SIZE);
+  ASSERT_EQ(input, decode(unchecked));
+
+  // version 1 has no flags byte and always has checksum
+  std::string version_1 = encode_framed(input);
+  version_1.erase(version_index + 1, 1);
+  version_1[version_index] = 1;
+  ASSERT_EQ(input, decode(version_1));
+
+  std::string unknown_version = encode_framed(input);
+  unknown_version[version_index] = huffman::FRAME_VERSION + 1;
+  EXPECT_THROW(decode(unknown_version), std::runtime_error);
+
+  std::string unknown_flags = encode_framed(input);
+  unknown_flags[version_index + 1] |= static_cast<char>(0x80);
+  EXPECT_THROW(decode(unknown_flags), std::runtime_error);
+
+  // stream must not end after continued member
+  std::string continued =
+      encode_framed(input, huffman::FRAME_FLAG_CONTINUED);
+  ASSERT_EQ(input + input, decode(continued + encode_framed(input)));
+  EXPECT_THROW(decode(continued), std::runtime_error);
+}
+
+TEST(correctness, append_members) {
+  std::string first(N, 'a');
+  std::string second = "bcd" + first;
+  std::stringstream appended(encode_framed(first, 0));
+  std::stringstream output;
+  output << encode_framed(second);
+  ASSERT_EQ(huffman::append_members(appended, output),
+            encode_framed(first, 0).size());
+  ASSERT_EQ(second + first, decode(output.str()));
+
+  std::stringstream members(output.str());
+  ASSERT_EQ(huffman::read_complete_members(members).size(), 2);
+
+  // existing data is appended to only if it is complete framed stream
+  std::stringstream legacy(encode_legacy(first));
+  EXPECT_THROW(huffman::read_complete_members(legacy), std::runtime_error);
+  std::string framed = encode_framed(first);
+  std::stringstream truncated(framed.substr(0, framed.size() - 1));
+  EXPECT_THROW(huffman::read_complete_members(truncated),
+               std::runtime_error);
+  std::stringstream continued(
+      encode_framed(first, huffman::FRAME_FLAG_CONTINUED));
+  EXPECT_THROW(huffman::append_members(continued, output),
+               std::runtime_error);
+
+  // original size is bounded by payload before output is allocated
+  std::string forged = framed;
+  forged[huffman::FRAME_MAGIC.size() + 2 + 5] = 1;
+  std::stringstream forged_members(forged);
+  EXPECT_THROW(huffman::read_members(forged_members), std::runtime_error);
+  std::stringstream truncated_members(framed.substr(0, framed.size() - 1));
+  EXPECT_THROW(huffman::read_members(truncated_members), std::runtime_error);
+}
+
+TEST(encoder, parallel) {
+  std::string big = make_input(5 * huffman::PARALLEL_CHUNK_SIZE / 2);
+  for (std::string const& input :
+       {std::string(), std::string("a"), std::string("abcdefg"), big}) {
+    encoder encoder_;
+    auto data = reinterpret_cast<uint8_t const*>(input.data());
+    encoder_.add_chars(data, input.size());
+    encoder_.compile();
+    std::string output(encoder_.get_output_size(), '\0');
+    encoder_.encode(data, input.size(), reinterpret_cast<uint8_t*>(output.data()),
+                    4);
+    ASSERT_EQ(encode_legacy(input), output);
+  }
+  encoder encoder_;
+  encoder_.add_chars(reinterpret_cast<uint8_t const*>("abc"), 3);
+  encoder_.compile();
+  std::string output(encoder_.get_output_size(), '\0');
+  EXPECT_THROW(encoder_.encode(reinterpret_cast<uint8_t const*>("abd"), 3,
+                               reinterpret_cast<uint8_t*>(output.data()), 1),
+               std::runtime_error);
+}
+
+TEST(encoder, sampled) {
+  std::string uniform;
+  for (size_t i = 0; i < N * 10; ++i) {
+    uniform.push_back(static_cast<char>(i * 7 % 97));
+  }
+  // the only char out of sample
+  std::string rare = uniform;
+  rare[N * 5 + 1] = static_cast<char>(200);
+  for (auto const& [input, missed] :
+       std::vector<std::pair<std::string, size_t>>{
+           {"", 0}, {"ab", 0}, {uniform, 0}, {rare, 1}}) {
+    auto data = reinterpret_cast<uint8_t const*>(input.data());
+    auto counts = huffman::sample_counts(data, input.size(), 1000);
+    for (bool legacy : {true, false}) {
+      std::stringstream output;
+      auto result = huffman::encode_sampled(
+          data, input.size(), counts, output, legacy,
+          huffman::FRAME_FLAG_CHECKSUM, 1000);
+      ASSERT_EQ(missed, result.missed_chars);
+      ASSERT_EQ(0, result.members_count);
+      ASSERT_EQ(output.str().size(), result.output_size);
+      ASSERT_LE(result.exact_output_size, result.output_size);
+      ASSERT_EQ(input, decode(output.str()));
+    }
+  }
+  std::stringstream output;
+  auto data = reinterpret_cast<uint8_t const*>(uniform.data());
+  auto result = huffman::encode_sampled(
+      data, uniform.size(), huffman::sample_counts(data, uniform.size(), 1000),
+      output, false, huffman::FRAME_FLAG_CHECKSUM, 1000);
+  // sample gives almost the same codes
+  ASSERT_LT(result.output_size, result.exact_output_size * 1.01);
+
+  // exact counts, which don't match data, have no escape codes
+  std::array<size_t, huffman::CHARS_COUNT> wrong{};
+  wrong['a'] = 3;
+  std::stringstream mismatched;
+  ASSERT_THROW(huffman::encode_sampled(reinterpret_cast<uint8_t const*>("abc"),
+                                       3, wrong, mismatched, false),
+               std::runtime_error);
+}
+
+namespace {
+// appends to string and can't seek, like a pipe
+struct pipe_buffer : std::streambuf {
+  std::string data;
+
+  int_type overflow(int_type ch) override {
+    if (ch != traits_type::eof()) {
+      data.push_back(static_cast<char>(ch));
+    }
+    return ch;
+  }
+
+  std::streamsize xsputn(char const* s, std::streamsize count) override {
+    data.append(s, static_cast<size_t>(count));
+    return count;
+  }
+};
+} // namespace
+
+TEST(encoder, sampled_unseekable) {
+  std::string input = make_input(huffman::SAMPLED_MEMBER_SIZE * 2 + N);
+  auto data = reinterpret_cast<uint8_t const*>(input.data());
+  auto counts = huffman::sample_counts(data, input.size());
+  for (bool legacy : {true, false}) {
+    pipe_buffer buffer;
+    std::ostream output(&buffer);
+    auto result =
+        huffman::encode_sampled(data, input.size(), counts, output, legacy);
+    // legacy stream can't be patched, so framed members are written
+    ASSERT_EQ(3, result.members_count);
+    ASSERT_EQ(buffer.data.size(), result.output_size);
+    ASSERT_LE(result.exact_output_size, result.output_size);
+    ASSERT_EQ(input, decode(buffer.data));
+  }
+}
+
+TEST(encoder, filters) {
+  std::string runs;
+  for (size_t i = 0; i < N; ++i) {
+    runs.append(i % 300, static_cast<char>('a' + i % 3));
+  }
+  std::string counters;
+  for (uint32_t i = 0; i < N; ++i) {
+    uint32_t value = i * i / 7;
+    counters.append(reinterpret_cast<char const*>(&value), sizeof(value));
+  }
+  counters += "tail";
+  for (char const* name : {"rle", "delta", "delta:4", "shuffle:4",
+                          "shuffle:3", "delta:255"}) {
+    huffman::filter filter_ = huffman::filter::parse(name);
+    for (std::string const& input :
+         {std::string(), std::string("a"), std::string("aa"),
+          std::string("aab"), runs, counters}) {
+      auto data = reinterpret_cast<uint8_t const*>(input.data());
+      std::stringstream output;
+      size_t size =
+          huffman::encode_filtered(data, input.size(), filter_, output);
+      std::string encoded = output.str();
+      ASSERT_EQ(encoded.size(), size);
+      ASSERT_EQ(input, decode(encoded));
+
+      std::string decoded(input.size(), '\0');
+      std::stringstream memory_input(encoded);
+      huffman::decoder decoder_;
+      ASSERT_EQ(decoder_.decode(memory_input,
+                                reinterpret_cast<uint8_t*>(decoded.data()),
+                                decoded.size()),
+                input.size());
+      ASSERT_EQ(input, decoded);
+
+      huffman::message message_{
+          reinterpret_cast<uint8_t const*>(encoded.data()), encoded.size(),
+          reinterpret_cast<uint8_t*>(decoded.data()), decoded.size()};
+      huffman::message_decoder message_decoder_;
+      ASSERT_EQ(message_decoder_.decode(message_), input.size());
+      ASSERT_EQ(input, decoded);
+
+      std::stringstream verify_input(encoded);
+      ASSERT_EQ(input.size(), decoder_.verify(verify_input).second);
+
+      // the smallest chunk fits the longest run
+      std::string filtered_data;
+      filter_.apply(data, input.size(), filtered_data);
+      std::string chunk(257, '\0');
+      std::string chunked;
+      ASSERT_EQ(input.size(),
+                filter_.revert_chunks(
+                    reinterpret_cast<uint8_t const*>(filtered_data.data()),
+                    filtered_data.size(), input.size(),
+                    reinterpret_cast<uint8_t*>(chunk.data()), chunk.size(),
+                    [&](size_t size) { chunked.append(chunk, 0, size); }));
+      ASSERT_EQ(input, chunked);
+    }
+  }
+  // runs are coded with less symbols
+  auto data = reinterpret_cast<uint8_t const*>(runs.data());
+  std::stringstream filtered;
+  huffman::encode_filtered(data, runs.size(), huffman::filter::parse("rle"),
+                           filtered);
+  ASSERT_LT(filtered.str().size() * 10, encode_framed(runs).size());
+
+  // filtered data is kept whole, limit must cover it
+  huffman::decoder limited;
+  limited.set_memory_limit(runs.size());
+  std::stringstream limited_input(filtered.str());
+  std::stringstream limited_output;
+  EXPECT_THROW(limited.decode(limited_input, limited_output),
+               std::runtime_error);
+  limited.set_memory_limit(4 * runs.size());
+  std::stringstream enough_input(filtered.str());
+  limited.decode(enough_input, limited_output);
+  ASSERT_EQ(runs, limited_output.str());
+  ASSERT_GE(4 * runs.size(), limited.get_memory_usage());
+
+  EXPECT_THROW(huffman::filter::parse("zip"), std::runtime_error);
+  EXPECT_THROW(huffman::filter::parse("delta:0"), std::runtime_error);
+  EXPECT_THROW(huffman::filter::parse("rle:2"), std::runtime_error);
+  // original size can't be restored from payload
+  std::string expanded = filtered.str();
+  expanded[6 + 7] = 1;
+  EXPECT_THROW(decode(expanded), std::runtime_error);
+  huffman::decoder verifier;
+  std::stringstream expanded_input(expanded);
+  EXPECT_THROW(verifier.verify(expanded_input), std::runtime_error);
+  std::string unknown_filter = filtered.str();
+  unknown_filter[huffman::FRAME_HEADER_SIZE] = 100;
+  EXPECT_THROW(decode(unknown_filter), std::runtime_error);
+  // count of run is lost
+  std::string broken(
+      huffman::filter::parse("rle").max_filtered_size(2), '\0');
+  EXPECT_THROW(huffman::filter::parse("rle").revert(
+                   reinterpret_cast<uint8_t const*>("aa"), 2,
+                   reinterpret_cast<uint8_t*>(broken.data()), broken.size()),
+               std::runtime_error);
+}
+
+TEST(decoder, verify) {
+  std::string input(N, 'a');
+  input += "bcd";
+  std::string framed = encode_framed(input);
+  for (std::string const& encoded :
+       {encode_legacy(input), framed, framed + encode_framed(input, 0),
+        encode_legacy(std::string())}) {
+    std::stringstream stream(encoded);
+    huffman::decoder decoder_;
+    decoder_.set_buffer_size(16);
+    std::stringstream expected(encoded);
+    std::stringstream decoded;
+    ASSERT_EQ(huffman::decoder().decode(expected, decoded),
+              decoder_.verify(stream));
+  }
+  // the same checks as in decoding
+  std::string corrupted = framed;
+  corrupted.back() ^= 1;
+  std::stringstream corrupted_stream(corrupted);
+  EXPECT_THROW(huffman::decoder().verify(corrupted_stream),
+               std::runtime_error);
+  std::string continued = encode_framed(input, huffman::FRAME_FLAG_CONTINUED);
+  std::stringstream continued_stream(continued);
+  EXPECT_THROW(huffman::decoder().verify(continued_stream),
+               std::runtime_error);
+  continued_stream.clear();
+  continued_stream.seekg(0);
+  ASSERT_EQ(input.size(),
+            huffman::decoder().verify_member(continued_stream).second);
+
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "huffman-verify-test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directory(directory);
+  std::ofstream(directory / "input", std::ios::binary) << input;
+  huffman::batch_options options;
+  options.threads = 2;
+  options.block_size = N / 3;
+  huffman::compress_files({{directory / "input", directory / "compressed"}},
+                          options);
+  std::ofstream(directory / "corrupted", std::ios::binary) << corrupted;
+  auto results = huffman::verify_files(
+      {directory / "compressed", directory / "corrupted", directory / "missing"},
+      options);
+  ASSERT_EQ("", results[0].error);
+  ASSERT_EQ(input.size(), results[0].output_size);
+  ASSERT_EQ("Checksum mismatch", results[1].error);
+  ASSERT_NE("", results[2].error);
+  std::filesystem::remove_all(directory);
+}
+
+TEST(codec, sessions) {
+  std::vector<std::string> inputs;
+  std::array<size_t, huffman::CHARS_COUNT> counts{};
+  for (size_t i = 0; i < 8; ++i) {
+    std::string input;
+    for (size_t j = 0; j < N; ++j) {
+      input.push_back(static_cast<char>((j * j + i) % 97));
+    }
+    for (char ch : input) {
+      ++counts[static_cast<uint8_t>(ch)];
+    }
+    inputs.push_back(input);
+  }
+  auto shared = std::make_shared<huffman::codec const>(counts);
+  // serialized codec and header of stream give the same codes
+  std::string const& serialized = shared->serialize();
+  huffman::codec parsed(reinterpret_cast<uint8_t const*>(serialized.data()),
+                        serialized.size());
+  ASSERT_EQ(serialized, parsed.serialize());
+  for (size_t ch = 0; ch < huffman::CHARS_COUNT; ++ch) {
+    ASSERT_EQ(shared->get_code(ch).size(), parsed.get_code(ch).size());
+  }
+  ASSERT_EQ(shared->get_code_values(), parsed.get_code_values());
+
+  // every thread has its own sessions and no copy of tables
+  std::vector<std::string> encoded(inputs.size());
+  std::vector<std::string> decoded(inputs.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    threads.emplace_back([&, i] {
+      huffman::encode_session encoder_(shared);
+      huffman::decode_session decoder_(shared);
+      auto data = reinterpret_cast<uint8_t const*>(inputs[i].data());
+      encoder_.encode(data, inputs[i].size(), encoded[i]);
+      decoded[i].resize(inputs[i].size());
+      decoded[i].resize(decoder_.decode(
+          reinterpret_cast<uint8_t const*>(encoded[i].data()),
+          encoded[i].size(), reinterpret_cast<uint8_t*>(decoded[i].data()),
+          decoded[i].size()));
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ(inputs[i], decoded[i]);
+    // stream is read by any decoder
+    ASSERT_EQ(inputs[i], decode(encoded[i]));
+  }
+
+  huffman::encode_session encoder_(shared);
+  std::string output;
+  encoder_.encode(nullptr, 0, output);
+  ASSERT_EQ(std::string(1, '\0'), output);
+  ASSERT_EQ("", decode(output));
+  auto unknown = reinterpret_cast<uint8_t const*>("\xff");
+  EXPECT_THROW(encoder_.encode(unknown, 1, output), std::runtime_error);
+  std::string other = encode_legacy("abc");
+  EXPECT_THROW(huffman::decode_session(shared).decode(
+                   reinterpret_cast<uint8_t const*>(other.data()),
+                   other.size(), nullptr, 0),
+               std::runtime_error);
+  EXPECT_THROW(huffman::codec(std::array<size_t, huffman::CHARS_COUNT>{}),
+               std::runtime_error);
+
+  // codec compiled by encoder gives the same streams
+  encoder compiled;
+  compiled.add_chars(reinterpret_cast<uint8_t const*>(inputs[0].data()),
+                     inputs[0].size());
+  compiled.compile();
+  huffman::encode_session(compiled.get_codec())
+      .encode(reinterpret_cast<uint8_t const*>(inputs[0].data()),
+              inputs[0].size(), output);
+  ASSERT_EQ(encode_legacy(inputs[0]), output);
+}
+
+TEST(decoder, speculative) {
+  std::string text = make_input(100000);
+  // all codes are 8 bits and start at odd bits, so chunks that start at
+  // bytes never sync with exact decoding
+  std::string uniform;
+  for (size_t i = 0; i < 100000; ++i) {
+    uniform.push_back(static_cast<char>(i % 256));
+  }
+  for (std::string const& input :
+       {std::string(), std::string("a"), std::string("abcdefg"), text,
+        uniform}) {
+    std::string encoded = encode_legacy(input);
+    auto data = reinterpret_cast<uint8_t const*>(encoded.data());
+    for (size_t chunk_size : {size_t(1), size_t(1000), size_t(4096)}) {
+      std::stringstream output;
+      ASSERT_EQ(std::make_pair(encoded.size(), input.size()),
+                decode_speculative(data, encoded.size(), output, 3,
+                                   chunk_size));
+      ASSERT_EQ(input, output.str());
+    }
+  }
+  std::string encoded = encode_legacy(text);
+  std::stringstream output;
+  EXPECT_THROW(decode_speculative(reinterpret_cast<uint8_t const*>(
+                                      encoded.data()),
+                                  encoded.size() - 1, output, 3, 1000),
+               std::runtime_error);
+  encoded = encode_framed(text);
+  EXPECT_THROW(decode_speculative(reinterpret_cast<uint8_t const*>(
+                                      encoded.data()),
+                                  encoded.size(), output, 3),
+               std::runtime_error);
+}
+
+TEST(search, matches) {
+  std::string text;
+  for (size_t i = 0; i < N; ++i) {
+    text.push_back(static_cast<char>('a' + (i * i + (i & 1234)) % 3));
+  }
+  for (std::string pattern : {"a", "ab", "abcab", "aaaa", "cbacba"}) {
+    std::vector<size_t> expected;
+    for (size_t i = 0; i + pattern.size() <= text.size(); ++i) {
+      if (text.compare(i, pattern.size(), pattern) == 0) {
+        expected.push_back(i);
+      }
+    }
+    // writes of every size, so matches cross them
+    for (size_t write_size : {1, 2, 3, 7, 1000}) {
+      std::vector<size_t> found;
+      huffman::search_streambuf buffer(
+          pattern, [&found](size_t offset) { found.push_back(offset); });
+      std::ostream output(&buffer);
+      for (size_t i = 0; i < text.size(); i += write_size) {
+        output.write(text.data() + i,
+                     static_cast<std::streamsize>(
+                         std::min(write_size, text.size() - i)));
+      }
+      ASSERT_EQ(expected, found);
+    }
+    std::vector<size_t> found;
+    std::stringstream input(encode_framed(text));
+    ASSERT_EQ(expected.size(),
+              huffman::search(input, pattern, [&found](size_t offset) {
+                found.push_back(offset);
+              }));
+    ASSERT_EQ(expected, found);
+  }
+  std::stringstream input(encode_legacy(text));
+  EXPECT_THROW(huffman::search(input, "", [](size_t) {}), std::runtime_error);
+}
+
+TEST(correctness, decode_to_memory) {
+  std::string input = make_input(N);
+  for (std::string const& encoded :
+       {encode_framed(input) + encode_framed(input), encode_legacy(input)}) {
+    // framed stream has two members
+    size_t size = encoded[0] == 0 ? 2 * input.size() : input.size();
+    std::string output(size, '\0');
+    std::stringstream decoder_input(encoded);
+    decoder decoder_;
+    decoder_.set_buffer_size(64);
+    ASSERT_EQ(size, decoder_.decode(decoder_input,
+                                    reinterpret_cast<uint8_t*>(output.data()),
+                                    output.size()));
+    ASSERT_EQ(input, output.substr(0, input.size()));
+
+    // the same decoder decodes the stream again
+    std::stringstream again_input(encoded);
+    output.assign(size, '\0');
+    ASSERT_EQ(size, decoder_.decode(again_input,
+                                    reinterpret_cast<uint8_t*>(output.data()),
+                                    output.size()));
+    ASSERT_EQ(input, output.substr(0, input.size()));
+
+    std::stringstream small_input(encoded);
+    EXPECT_THROW(decoder_.decode(small_input,
+                                 reinterpret_cast<uint8_t*>(output.data()),
+                                 size - 1),
+                 std::runtime_error);
+  }
+}
+
+TEST(correctness, stats) {
+  std::string input = make_input(N);
+  encoder encoder_;
+  encoder_.enable_stats();
+  std::stringstream count_stream(input);
+  encoder_.add_chars(count_stream);
+  std::stringstream encoder_input(input);
+  std::stringstream encoder_output;
+  encoder_.encode_framed(encoder_input, encoder_output);
+
+  huffman::stats const& encoder_stats = encoder_.get_stats();
+  ASSERT_EQ(N, encoder_stats.input_bytes);
+  ASSERT_EQ(N, encoder_stats.symbols);
+  ASSERT_EQ(encoder_output.str().size(), encoder_stats.output_bytes);
+  ASSERT_LT(0, encoder_stats.buffer_flushes);
+  ASSERT_LT(0, encoder_stats.counting_time);
+  ASSERT_LT(0, encoder_stats.coding_time);
+
+  decoder decoder_;
+  std::stringstream decoder_output;
+  decoder_.decode(encoder_output, decoder_output);
+  huffman::stats const& decoder_stats = decoder_.get_stats();
+  ASSERT_EQ(encoder_output.str().size(), decoder_stats.input_bytes);
+  ASSERT_EQ(N, decoder_stats.output_bytes);
+  ASSERT_EQ(N, decoder_stats.symbols);
+  ASSERT_EQ(0, decoder_stats.coding_time);
+
+  // paths of --threads 2 collect stats too
+  std::string big_input = make_input(huffman::PARALLEL_CHUNK_SIZE * 2 + N);
+  auto data = reinterpret_cast<uint8_t const*>(big_input.data());
+  encoder parallel;
+  parallel.enable_stats();
+  parallel.add_chars(data, big_input.size());
+  parallel.compile();
+  std::string encoded(parallel.get_output_size(), '\0');
+  parallel.encode(data, big_input.size(),
+                  reinterpret_cast<uint8_t*>(encoded.data()), 2);
+  ASSERT_EQ(big_input.size(), parallel.get_stats().input_bytes);
+  ASSERT_EQ(encoded.size(), parallel.get_stats().output_bytes);
+  ASSERT_LT(0, parallel.get_stats().coding_time);
+
+  huffman::stats speculative;
+  std::stringstream speculative_output;
+  decode_speculative(reinterpret_cast<uint8_t const*>(encoded.data()),
+                     encoded.size(), speculative_output, 2,
+                     huffman::SPECULATIVE_CHUNK_SIZE, &speculative);
+  ASSERT_EQ(big_input, speculative_output.str());
+  ASSERT_EQ(encoded.size(), speculative.input_bytes);
+  ASSERT_EQ(big_input.size(), speculative.output_bytes);
+  ASSERT_EQ(big_input.size(), speculative.symbols);
+  ASSERT_LT(0, speculative.coding_time);
+}
+
+TEST(correctness, buffer_sizes) {
+  std::string input = make_input(N, 251);
+  std::string expected = encode_framed(input);
+  for (size_t buffer_size : {1, 3, 100, 100000}) {
+    encoder encoder_;
+    encoder_.set_buffer_size(buffer_size);
+    std::stringstream count_stream(input);
+    encoder_.add_chars(count_stream);
+    std::stringstream encoder_input(input);
+    std::stringstream encoder_output;
+    encoder_.encode_framed(encoder_input, encoder_output);
+    ASSERT_EQ(expected, encoder_output.str());
+
+    decoder decoder_;
+    decoder_.set_buffer_size(buffer_size);
+    std::stringstream decoder_output;
+    decoder_.decode(encoder_output, decoder_output);
+    ASSERT_EQ(input, decoder_output.str());
+    if (buffer_size < 100) {
+      ASSERT_LT(N / 10, decoder_.get_stats().buffer_flushes);
+    }
+  }
+}
+
+TEST(correctness, memory_limit) {
+  std::string input = make_input(N, 251);
+  std::string encoded = encode_framed(input);
+  size_t limit = 256 * 1024;
+
+  encoder encoder_;
+  encoder_.set_buffer_size(1024);
+  encoder_.set_memory_limit(limit);
+  std::stringstream count_stream(input);
+  encoder_.add_chars(count_stream);
+  std::stringstream encoder_input(input);
+  std::stringstream encoder_output;
+  encoder_.encode_framed(encoder_input, encoder_output);
+  ASSERT_EQ(encoded, encoder_output.str());
+  ASSERT_GE(limit, encoder_.get_memory_usage());
+
+  decoder decoder_;
+  decoder_.set_buffer_size(1024);
+  decoder_.set_memory_limit(limit);
+  std::stringstream decoder_input(encoded);
+  std::stringstream decoder_output;
+  decoder_.decode(decoder_input, decoder_output);
+  ASSERT_EQ(input, decoder_output.str());
+  ASSERT_GE(limit, decoder_.get_memory_usage());
+
+  decoder small_decoder;
+  small_decoder.set_memory_limit(1024);
+  std::stringstream small_input(encoded);
+  std::stringstream small_output;
+  ASSERT_THROW(small_decoder.decode(small_input, small_output),
+               std::runtime_error);
+
+  encoder small_encoder;
+  small_encoder.set_memory_limit(1024);
+  std::stringstream small_count_stream(input);
+  small_encoder.add_chars(small_count_stream);
+  std::stringstream small_encoder_input(input);
+  std::stringstream small_encoder_output;
+  ASSERT_THROW(
+      small_encoder.encode_framed(small_encoder_input, small_encoder_output),
+      std::runtime_error);
+  // limit is checked before member is started
+  ASSERT_EQ("", small_encoder_output.str());
+
+  // decoder checks memory of tree before it is built
+  std::vector<uint16_t> traversal = {256, 256, 'a', 'b', 'c'};
+  ASSERT_EQ(tree(traversal).memory_usage(), tree::memory_usage(3));
+}
+
+// 'a' + i has code of length i + 1, the last two codes have equal lengths
+static constexpr std::array<uint8_t, huffman::CHARS_COUNT> skewed_lengths() {
+  std::array<uint8_t, huffman::CHARS_COUNT> result{};
+  for (size_t i = 0; i < 20; ++i) {
+    result['a' + i] = static_cast<uint8_t>(i + 1);
+  }
+  result['a' + 20] = 20;
+  return result;
+}
+
+static constexpr static_table SKEWED_TABLE(skewed_lengths());
+static_assert(SKEWED_TABLE.code_size('c') == 3);
+static_assert(SKEWED_TABLE.code_size('u') == 20);
+
+TEST(static_table, constexpr_table) {
+  std::string input;
+  for (size_t i = 0; i < N; ++i) {
+    input.push_back(static_cast<char>('a' + (i * i + (i & 1234)) % 21));
+  }
+  std::string encoded;
+  SKEWED_TABLE.encode(reinterpret_cast<uint8_t const*>(input.data()),
+                      input.size(), encoded);
+  std::string decoded;
+  SKEWED_TABLE.decode(reinterpret_cast<uint8_t const*>(encoded.data()),
+                      encoded.size(), input.size(), decoded);
+  ASSERT_EQ(input, decoded);
+  ASSERT_THROW(SKEWED_TABLE.decode(
+                   reinterpret_cast<uint8_t const*>(encoded.data()),
+                   encoded.size() / 2, input.size(), decoded),
+               std::runtime_error);
+  std::string unexpected = "abz";
+  ASSERT_THROW(SKEWED_TABLE.encode(
+                   reinterpret_cast<uint8_t const*>(unexpected.data()),
+                   unexpected.size(), encoded),
+               std::runtime_error);
+}
+
+TEST(static_table, from_counts) {
+  std::string input = make_input(N);
+  std::array<size_t, huffman::CHARS_COUNT> counts{};
+  for (char ch : input) {
+    ++counts[static_cast<uint8_t>(ch)];
+  }
+  std::array<uint8_t, huffman::CHARS_COUNT> lengths{};
+  tree::get_code_lengths(counts, lengths);
+  static_table table(lengths);
+  size_t bits = 0;
+  for (size_t i = 0; i < huffman::CHARS_COUNT; ++i) {
+    ASSERT_EQ(lengths[i], table.code_size(static_cast<uint8_t>(i)));
+    bits += counts[i] * lengths[i];
+  }
+  std::string encoded;
+  table.encode(reinterpret_cast<uint8_t const*>(input.data()), input.size(),
+               encoded);
+  ASSERT_EQ((bits + 7) / 8, encoded.size());
+  std::string decoded;
+  table.decode(reinterpret_cast<uint8_t const*>(encoded.data()),
+               encoded.size(), input.size(), decoded);
+  ASSERT_EQ(input, decoded);
+}
+
+TEST(static_table, incorrect_lengths) {
+  std::array<uint8_t, huffman::CHARS_COUNT> lengths{};
+  ASSERT_THROW(static_table{lengths}, std::runtime_error);
+  lengths[0] = lengths[1] = lengths[2] = 1;
+  ASSERT_THROW(static_table{lengths}, std::runtime_error);
+  lengths[2] = static_table::MAX_CODE_SIZE + 1;
+  ASSERT_THROW(static_table{lengths}, std::runtime_error);
+}
+
+TEST(messages, decode) {
+  std::vector<std::string> inputs = {"", "a", "aaaa", "hello", "hello",
+                                     "abracadabra", "hello"};
+  for (size_t i = 0; i < 100; ++i) {
+    inputs.push_back(std::string(i % 7 + 1, static_cast<char>('a' + i % 5)) +
+                     std::to_string(i));
+  }
+  std::vector<std::string> encoded;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    encoded.push_back(i % 2 == 0 ? encode_legacy(inputs[i])
+                                 : encode_framed(inputs[i]));
+  }
+  // corrupted checksum, truncated message and too small output
+  encoded.push_back(encode_framed("checksum"));
+  encoded.back().back() = static_cast<char>(encoded.back().back() ^ 1);
+  encoded.push_back(encode_legacy("truncated message").substr(0, 3));
+  encoded.push_back(encode_legacy("too long"));
+
+  std::vector<std::string> outputs(encoded.size(), std::string(100, '\0'));
+  outputs.back().resize(3);
+  std::vector<message> messages;
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    messages.push_back(
+        {reinterpret_cast<uint8_t const*>(encoded[i].data()),
+         encoded[i].size(), reinterpret_cast<uint8_t*>(outputs[i].data()),
+         outputs[i].size()});
+  }
+  message_decoder decoder_;
+  auto results = decoder_.decode(messages);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ("", results[i].error);
+    ASSERT_EQ(inputs[i], outputs[i].substr(0, results[i].output_size));
+  }
+  ASSERT_EQ("Checksum mismatch", results[inputs.size()].error);
+  ASSERT_NE("", results[inputs.size() + 1].error);
+  ASSERT_NE("", results[inputs.size() + 2].error);
+  // "hello" is encoded with the same header three times
+  ASSERT_GT(inputs.size(), decoder_.cached_trees());
+
+  auto parallel_results = huffman::decode_messages(messages, 4);
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(results[i].output_size, parallel_results[i].output_size);
+    ASSERT_EQ(results[i].error, parallel_results[i].error);
+  }
+}
+
+// Every engine must decode adversarial inputs back: single symbol, deep
+// tree with Fibonacci counts, all chars, and random data
+TEST(differential, engines) {
+  // header of 7 chars takes exactly two words of bit_sequence
+  std::vector<std::string> inputs = {"", "a", std::string(N, 'b'), "ab",
+                                     "abcdefg"};
+  std::string deep;
+  size_t previous = 1;
+  size_t current = 1;
+  for (size_t i = 0; i < 24; ++i) {
+    deep += std::string(current, static_cast<char>(i));
+    previous = std::exchange(current, current + previous);
+  }
+  inputs.push_back(deep);
+  std::string all_chars;
+  for (size_t i = 0; i < N; ++i) {
+    all_chars.push_back(static_cast<char>(i % huffman::CHARS_COUNT));
+  }
+  inputs.push_back(all_chars);
+  std::string random;
+  uint32_t state = 12345;
+  for (size_t i = 0; i < N; ++i) {
+    state = state * 1103515245 + 12345;
+    random.push_back(static_cast<char>((state >> 16) % 251));
+  }
+  inputs.push_back(random);
+
+  for (std::string const& input : inputs) {
+    for (std::string const& encoded :
+         {encode_legacy(input), encode_framed(input), encode_framed(input, 0)}) {
+      ASSERT_EQ(input, decode(encoded));
+      for (size_t buffer_size : {1, 3, 64}) {
+        std::stringstream decoder_input(encoded);
+        std::stringstream decoder_output;
+        decoder decoder_;
+        decoder_.set_buffer_size(buffer_size);
+        decoder_.decode(decoder_input, decoder_output);
+        ASSERT_EQ(input, decoder_output.str());
+      }
+      std::string output(input.size(), '\0');
+      message_decoder message_decoder_;
+      size_t output_size = message_decoder_.decode(
+          {reinterpret_cast<uint8_t const*>(encoded.data()), encoded.size(),
+           reinterpret_cast<uint8_t*>(output.data()), output.size()});
+      ASSERT_EQ(input, output.substr(0, output_size));
+    }
+
+    std::array<size_t, huffman::CHARS_COUNT> counts{};
+    for (char ch : input) {
+      ++counts[static_cast<uint8_t>(ch)];
+    }
+    std::array<uint8_t, huffman::CHARS_COUNT> lengths{};
+    tree::get_code_lengths(counts, lengths);
+    if (input.size() > 1) {
+      static_table table(lengths);
+      std::string encoded;
+      table.encode(reinterpret_cast<uint8_t const*>(input.data()),
+                   input.size(), encoded);
+      std::string decoded;
+      table.decode(reinterpret_cast<uint8_t const*>(encoded.data()),
+                   encoded.size(), input.size(), decoded);
+      ASSERT_EQ(input, decoded);
+    }
+  }
+}
+
+static std::string decode_or_error(std::string const& input,
+                                   size_t buffer_size) {
+  std::stringstream decoder_input(input);
+  std::stringstream decoder_output;
+  decoder decoder_;
+  decoder_.set_buffer_size(buffer_size);
+  try {
+    decoder_.decode(decoder_input, decoder_output);
+  } catch (std::runtime_error const& e) {
+    return std::string("error: ") + e.what();
+  }
+  return decoder_output.str();
+}
+
+// Engines must agree on corrupted and truncated streams
+TEST(differential, corrupted) {
+  std::string input = "differential testing of corrupted streams";
+  for (std::string const& encoded :
+       {encode_legacy(input), encode_framed(input), encode_framed(input, 0)}) {
+    for (size_t i = 0; i < encoded.size() * 8; ++i) {
+      std::string corrupted = encoded;
+      corrupted[i / 8] = static_cast<char>(corrupted[i / 8] ^ (1 << (i % 8)));
+      for (std::string const& variant :
+           {corrupted, encoded.substr(0, i / 8)}) {
+        std::string result = decode_or_error(variant, 4096);
+        ASSERT_EQ(result, decode_or_error(variant, 1)) << i;
+        std::string output(variant.size() * 8, '\0');
+        message_decoder message_decoder_;
+        try {
+          size_t output_size = message_decoder_.decode(
+              {reinterpret_cast<uint8_t const*>(variant.data()),
+               variant.size(), reinterpret_cast<uint8_t*>(output.data()),
+               output.size()});
+          ASSERT_EQ(result, output.substr(0, output_size)) << i;
+        } catch (std::runtime_error const&) {
+        }
+      }
+    }
+  }
+}
+
+TEST(table_cache, shared_trees) {
+  std::vector<std::string> encoded;
+  for (char const* input : {"abc", "abcd", "abcde", "abc"}) {
+    encoded.push_back(encode_legacy(input));
+  }
+  auto header = [&](size_t i) {
+    return reinterpret_cast<uint8_t const*>(encoded[i].data());
+  };
+  table_cache cache(1024 * 1024);
+  auto first = cache.get(header(0));
+  ASSERT_EQ(first, cache.get(header(3)));
+  ASSERT_EQ(1, cache.size());
+  cache.get(header(1));
+  cache.get(header(2));
+  ASSERT_EQ(3, cache.size());
+
+  // the least recently used tree is evicted first
+  cache.get(header(0));
+  cache.set_capacity(cache.memory_usage() - 1);
+  ASSERT_EQ(2, cache.size());
+  ASSERT_EQ(first, cache.get(header(0)));
+  cache.set_capacity(0);
+  ASSERT_EQ(0, cache.size());
+  ASSERT_NE(first, cache.get(header(0)));
+  ASSERT_EQ(0, cache.memory_usage());
+
+  std::vector<std::shared_ptr<huffman::codec const>> trees(64);
+  {
+    table_cache shared_cache(1024 * 1024);
+    thread_pool pool(4);
+    for (size_t i = 0; i < trees.size(); ++i) {
+      pool.submit([&, i] { trees[i] = shared_cache.get(header(i % 2 * 3)); });
+    }
+    pool.wait();
+  }
+  for (auto const& tree_ : trees) {
+    ASSERT_NE(nullptr, tree_);
+  }
+
+  table_cache::global().clear();
+  ASSERT_EQ("abcd", decode(encoded[1]));
+  ASSERT_EQ("abcd", decode(encoded[1]));
+  ASSERT_EQ(1, table_cache::global().size());
+}
+
+TEST(encoder, output_size_from_counts) {
+  for (std::string const& input :
+       {std::string(), std::string("a"), std::string(100, 'b'),
+        std::string("abracadabra")}) {
+    encoder encoder_;
+    std::array<size_t, huffman::CHARS_COUNT> counts{};
+    for (char ch : input) {
+      encoder_.add_char(static_cast<uint8_t>(ch));
+      ++counts[static_cast<uint8_t>(ch)];
+    }
+    encoder_.compile();
+    ASSERT_EQ(encoder_.get_output_size(), encoder::get_output_size(counts));
+  }
+}
+
+TEST(partition, mixed_content) {
+  constexpr size_t GRANULE_SIZE = 1024;
+  std::string input;
+  for (size_t i = 0; i < 16 * GRANULE_SIZE; ++i) {
+    input.push_back(static_cast<char>('a' + (i * i + (i & 1234)) % 7));
+  }
+  for (size_t i = 0; i < 16 * GRANULE_SIZE; ++i) {
+    input.push_back(static_cast<char>(128 + (i * 7919) % 101));
+  }
+  auto data = reinterpret_cast<uint8_t const*>(input.data());
+  std::vector<huffman::block> blocks =
+      huffman::partition(data, input.size(), GRANULE_SIZE);
+  ASSERT_EQ(2, blocks.size());
+  ASSERT_EQ(16 * GRANULE_SIZE, blocks[1].offset);
+
+  std::stringstream output;
+  huffman::encode_blocks(data, blocks, output);
+  ASSERT_EQ(blocks[0].encoded_size + blocks[1].encoded_size,
+            output.str().size());
+  ASSERT_GT(encode_framed(input).size(), output.str().size());
+  ASSERT_EQ(input, decode(output.str()));
+
+  std::string uniform = input.substr(0, 16 * GRANULE_SIZE);
+  ASSERT_EQ(1, huffman::partition(reinterpret_cast<uint8_t const*>(
+                                      uniform.data()),
+                                  uniform.size(), GRANULE_SIZE)
+                   .size());
+  ASSERT_EQ(1, huffman::partition(data, 0, GRANULE_SIZE).size());
+}
+
+TEST(thread_pool, nested_tasks) {
+  std::atomic<size_t> count{0};
+  thread_pool pool(4);
+  for (size_t i = 0; i < N / 10; ++i) {
+    pool.submit([&pool, &count] {
+      for (size_t j = 0; j < 10; ++j) {
+        pool.submit([&count] { ++count; });
+      }
+    });
+  }
+  pool.wait();
+  ASSERT_EQ(N, count);
+}
+
+TEST(thread_pool, exception) {
+  thread_pool pool(2);
+  pool.submit([] { throw std::runtime_error("task error"); });
+  EXPECT_THROW(pool.wait(), std::runtime_error);
+  std::atomic<size_t> count{0};
+  pool.submit([&count] { ++count; });
+  pool.wait();
+  ASSERT_EQ(1, count);
+}
+
+TEST(batch, blocks) {
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "huffman-batch-test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directory(directory);
+  std::string input = make_input(N);
+  std::string small = input.substr(0, N / 5);
+  std::ofstream(directory / "input", std::ios::binary) << input;
+  std::ofstream(directory / "small", std::ios::binary) << small;
+
+  huffman::batch_options options;
+  options.threads = 3;
+  options.block_size = N / 3;
+  auto results = huffman::compress_files(
+      {{directory / "input", directory / "input.huf"},
+       {directory / "small", directory / "small.huf"}},
+      options);
+  ASSERT_EQ("", results[0].error);
+  ASSERT_EQ("", results[1].error);
+  // blocks are members, the last one isn't continued
+  std::ifstream compressed(directory / "input.huf", std::ios::binary);
+  std::vector<huffman::frame_member> members =
+      huffman::read_members(compressed);
+  ASSERT_EQ(4, members.size());
+  for (size_t i = 0; i < members.size(); ++i) {
+    ASSERT_EQ(i + 1 != members.size(),
+              members[i].header.has_flag(huffman::FRAME_FLAG_CONTINUED));
+  }
+  ASSERT_EQ(members.back().offset + members.back().size(),
+            results[0].output_size);
+
+  results = huffman::decompress_files(
+      {{directory / "input.huf", directory / "input.out"},
+       {directory / "small.huf", directory / "small.out"}},
+      options);
+  ASSERT_EQ("", results[0].error);
+  ASSERT_EQ(input.size(), results[0].output_size);
+  ASSERT_EQ(small.size(), results[1].output_size);
+  for (auto const& [name, expected] :
+       {std::pair<char const*, std::string const&>{"input.out", input},
+        {"small.out", small}}) {
+    std::ifstream decompressed(directory / name, std::ios::binary);
+    std::stringstream output;
+    output << decompressed.rdbuf();
+    ASSERT_EQ(expected, output.str());
+  }
+
+  // output isn't allocated for sizes, that payloads can't be decoded to
+  std::stringstream forged;
+  forged << std::ifstream(directory / "input.huf", std::ios::binary).rdbuf();
+  std::string forged_data = forged.str();
+  forged_data[huffman::FRAME_MAGIC.size() + 2 + 5] = 1;
+  std::ofstream(directory / "forged.huf", std::ios::binary) << forged_data;
+  results = huffman::decompress_files(
+      {{directory / "forged.huf", directory / "forged.out"}}, options);
+  ASSERT_NE("", results[0].error);
+  ASSERT_FALSE(std::filesystem::exists(directory / "forged.out"));
+  std::filesystem::remove_all(directory);
+}
+
+TEST(server, requests) {
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "huffman-server-test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directory(directory);
+  std::string input = make_input(N);
+  std::ofstream(directory / "input", std::ios::binary) << input;
+
+  huffman::batch_options options;
+  options.threads = 2;
+  options.block_size = N / 3;
+  huffman::server server_(directory / "socket", options);
+  std::thread thread([&server_] { server_.run(); });
+  huffman::request request_;
+  request_.files = {{directory / "input", directory / "compressed"},
+                    {directory / "missing", directory / "compressed2"}};
+  auto results = huffman::send_request(directory / "socket", request_);
+  ASSERT_EQ(2, results.size());
+  ASSERT_EQ("", results[0].error);
+  ASSERT_EQ(input.size(), results[0].input_size);
+  ASSERT_NE("", results[1].error);
+  request_.compress = false;
+  request_.files = {{directory / "compressed", directory / "decompressed"}};
+  results = huffman::send_request(directory / "socket", request_);
+  ASSERT_EQ(input.size(), results[0].output_size);
+  huffman::stop_server(directory / "socket");
+  thread.join();
+
+  std::ifstream decompressed(directory / "decompressed", std::ios::binary);
+  std::stringstream output;
+  output << decompressed.rdbuf();
+  ASSERT_EQ(input, output.str());
+  EXPECT_THROW(huffman::send_request(directory / "socket", request_),
+               std::runtime_error);
+  std::filesystem::remove_all(directory);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST(server, idle_connection) {
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "huffman-idle-test";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directory(directory);
+  huffman::server server_(directory / "socket", huffman::batch_options());
+  std::thread thread([&server_] { server_.run(); });
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::string name = (directory / "socket").string();
+  std::copy(name.begin(), name.end(), address.sun_path);
+  auto connect_to_server = [&address] {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    connect(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address));
+    return fd;
+  };
+  // client, that sends nothing, is dropped after timeout
+  int idle = connect_to_server();
+  // files count is bigger than request can contain
+  int forged = connect_to_server();
+  std::string body = {6, 0, 0, 0, huffman::REQUEST_COMPRESS, 1, -1, -1, -1, -1};
+  ASSERT_EQ(body.size(), write(forged, body.data(), body.size()));
+  // client hangs up before response, writing it mustn't raise SIGPIPE
+  int hung_up = connect_to_server();
+  std::string path = (directory / "missing").string();
+  std::string request_body = {huffman::REQUEST_COMPRESS, 1, 1, 0, 0, 0};
+  for (size_t i = 0; i < 2; ++i) {
+    request_body += {static_cast<char>(path.size()), 0, 0, 0};
+    request_body += path;
+  }
+  std::string message = {static_cast<char>(request_body.size()), 0, 0, 0};
+  message += request_body;
+  ASSERT_EQ(message.size(), write(hung_up, message.data(), message.size()));
+  close(hung_up);
+
+  huffman::request request_;
+  request_.files = {{directory / "missing", directory / "output"}};
+  auto results = huffman::send_request(directory / "socket", request_);
+  ASSERT_EQ(1, results.size());
+  ASSERT_NE("", results[0].error);
+  char response; // NOLINT(cppcoreguidelines-init-variables)
+  ASSERT_EQ(0, read(forged, &response, 1));
+  huffman::stop_server(directory / "socket");
+  thread.join();
+  close(idle);
+  close(forged);
+  std::filesystem::remove_all(directory);
+}
+#endif